@@ -3,13 +3,23 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <round.h>
+#include <string.h>
+#include "devices/pci.h"
 #include "devices/timer.h"
+#include "devices/virtio-blk.h"
+#include "intrinsic.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].  Positions with
+   no ATA disk may be filled by virtio disks (see virtio-blk.c),
+   which go through the same interface. */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
@@ -18,6 +28,9 @@
 #define reg_lbal(CHANNEL) ((CHANNEL)->reg_base + 3)     /* LBA 0:7. */
 #define reg_lbam(CHANNEL) ((CHANNEL)->reg_base + 4)     /* LBA 15:8. */
 #define reg_lbah(CHANNEL) ((CHANNEL)->reg_base + 5)     /* LBA 23:16. */
+/* With LBA48 the four registers above are two deep: the first
+   write to each supplies the high-order byte (count 15:8 and LBA
+   31:24, 39:32 and 47:40 respectively), the second the low. */
 #define reg_device(CHANNEL) ((CHANNEL)->reg_base + 6)   /* Device/LBA 27:24. */
 #define reg_status(CHANNEL) ((CHANNEL)->reg_base + 7)   /* Status (r/o). */
 #define reg_command(CHANNEL) reg_status (CHANNEL)       /* Command (w/o). */
@@ -32,6 +45,7 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -47,18 +61,69 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+#define CMD_READ_SECTOR_EXT 0x24        /* READ SECTOR EXT. */
+#define CMD_WRITE_SECTOR_EXT 0x34       /* WRITE SECTOR EXT. */
+#define CMD_READ_DMA_EXT 0x25           /* READ DMA EXT. */
+#define CMD_WRITE_DMA_EXT 0x35          /* WRITE DMA EXT. */
+
+/* Sectors reachable with 28-bit LBA commands. */
+#define LBA28_SECTORS (1ULL << 28)
+
+/* Bus master IDE port addresses, per channel.  The controller's
+   bus master registers are found through PCI, so channels without
+   them have BM_BASE 0 and use PIO only. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0)  /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)   /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)     /* PRD table. */
+
+/* Bus master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Direction: device to memory. */
+
+/* Bus master Status Register bits. */
+#define BM_STA_ERROR 0x02       /* Transfer failed (write 1 to clear). */
+#define BM_STA_INTR 0x04        /* Interrupt raised (write 1 to clear). */
+
+/* A physical region descriptor: one physically contiguous piece
+   of a DMA transfer, which may not cross a 64 kB boundary. */
+struct prd {
+	uint32_t addr;              /* Physical address. */
+	uint16_t size;              /* Byte count, 0 meaning 64 kB. */
+	uint16_t flags;             /* PRD_EOT on the last entry. */
+};
+#define PRD_EOT 0x8000          /* End of table. */
+
+/* A piece of a transfer: CNT sectors at BUFFER.  A command may
+   scatter its data over several. */
+struct segment {
+	uint8_t *buffer;
+	size_t cnt;
+};
+
+/* Sectors in the per-channel DMA bounce buffer, used for buffers
+   that cannot be handed to the controller directly. */
+#define BOUNCE_SECTORS (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Most sectors a single ATA command can transfer. */
+#define MAX_XFER_SECTORS 256
 
-/* An ATA device. */
+/* An ATA device, or a virtio device in its place. */
 struct disk {
 	char name[8];               /* Name, e.g. "hd0:1". */
 	struct channel *channel;    /* Channel disk is on. */
 	int dev_no;                 /* Device 0 or 1 for master or slave. */
 
 	bool is_ata;                /* 1=This device is an ATA disk. */
-	disk_sector_t capacity;     /* Capacity in sectors (if is_ata). */
-
-	long long read_cnt;         /* Number of sectors read. */
-	long long write_cnt;        /* Number of sectors written. */
+	bool dma;                   /* Device supports DMA (if is_ata). */
+	bool lba48;                 /* Device supports LBA48 (if is_ata). */
+	disk_sector_t capacity;     /* Capacity in sectors. */
+	struct vblk *vblk;          /* Virtio device, if not is_ata. */
+
+	struct diskstat stats;      /* Statistics.  Updated with interrupts
+	                               off. */
+	disk_sector_t next_sec;     /* Sector after the last request. */
 };
 
 /* An ATA channel (aka controller).
@@ -73,22 +138,44 @@ struct channel {
 								   any interrupt would be spurious. */
 	struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+	uint16_t bm_base;           /* Bus master base port, 0 for PIO only. */
+	struct prd *prdt;           /* PRD table, one page. */
+	uint8_t *bounce;            /* DMA bounce buffer, one page. */
+	bool dma_active;            /* True while a DMA command is running. */
+	uint8_t bm_status;          /* Bus master status at completion. */
+
+	struct lock queue_lock;     /* Protects the members below. */
+	struct condition queue_cond;    /* Signaled when a request arrives. */
+	struct list queue;          /* Pending disk_requests, sorted. */
+	int head_dev;               /* Device last served. */
+	disk_sector_t head_sec;     /* Sector after the last one served. */
+
 	struct disk devices[2];     /* The devices on this channel. */
 };
 
-/* We support the two "legacy" ATA channels found in a standard PC. */
-#define CHANNEL_CNT 2
+/* We support the two "legacy" ATA channels found in a standard PC,
+   plus a third channel that has no controller and only holds
+   virtio disks. */
+#define ATA_CHANNEL_CNT 2
+#define CHANNEL_CNT 3
 static struct channel channels[CHANNEL_CNT];
 
 static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+static bool select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
 
+static void setup_dma (void);
+static void channel_worker (void *);
+static void submit_and_wait (struct disk *, disk_sector_t, size_t cnt,
+		void *, bool write);
+static void submit_one (struct disk *, disk_sector_t, size_t cnt,
+		void *, bool write);
+
 static void wait_until_idle (const struct disk *);
 static bool wait_while_busy (const struct disk *);
 static void select_device (const struct disk *);
@@ -116,12 +203,23 @@ disk_init (void) {
 				c->reg_base = 0x170;
 				c->irq = 15 + 0x20;
 				break;
+			case 2:
+				c->reg_base = 0;
+				c->irq = 0;
+				break;
 			default:
 				NOT_REACHED ();
 		}
-		lock_init (&c->lock);
+		lock_init_named (&c->lock, "disk_channel");
 		c->expecting_interrupt = false;
 		sema_init (&c->completion_wait, 0);
+		c->bm_base = 0;
+		c->dma_active = false;
+		lock_init_named (&c->queue_lock, "disk_queue");
+		cond_init (&c->queue_cond);
+		list_init (&c->queue);
+		c->head_dev = 0;
+		c->head_sec = 0;
 
 		/* Initialize devices. */
 		for (dev_no = 0; dev_no < 2; dev_no++) {
@@ -131,10 +229,16 @@ disk_init (void) {
 			d->dev_no = dev_no;
 
 			d->is_ata = false;
+			d->dma = false;
+			d->lba48 = false;
 			d->capacity = 0;
+			d->vblk = NULL;
 
-			d->read_cnt = d->write_cnt = 0;
+			memset (&d->stats, 0, sizeof d->stats);
+			d->next_sec = 0;
 		}
+		if (chan_no >= ATA_CHANNEL_CNT)
+			continue;
 
 		/* Register interrupt handler. */
 		intr_register_ext (c->irq, interrupt_handler, c->name);
@@ -152,10 +256,42 @@ disk_init (void) {
 				identify_ata_device (&c->devices[dev_no]);
 	}
 
+	setup_dma ();
+
+	/* Put virtio disks where there are no ATA disks. */
+	vblk_init ();
+	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) {
+		int dev_no;
+
+		for (dev_no = 0; dev_no < 2; dev_no++) {
+			struct disk *d = &channels[chan_no].devices[dev_no];
+
+			if (d->is_ata)
+				continue;
+			d->vblk = vblk_get (chan_no * 2 + dev_no);
+			if (d->vblk != NULL) {
+				snprintf (d->name, sizeof d->name, "vd%zu:%d", chan_no, dev_no);
+				d->capacity = vblk_capacity (d->vblk);
+			}
+		}
+	}
+
+	/* Start a worker for each channel with a disk on it. */
+	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) {
+		struct channel *c = &channels[chan_no];
+
+		if (c->devices[0].is_ata || c->devices[1].is_ata)
+			if (thread_create (c->name, PRI_MAX, channel_worker, c) == TID_ERROR)
+				PANIC ("%s: can't create worker thread", c->name);
+	}
+
 	/* DO NOT MODIFY BELOW LINES. */
 	register_disk_inspect_intr ();
 }
 
+static void print_histogram (const char *name, const char *what,
+		const uint64_t hist[DISKSTAT_BUCKETS]);
+
 /* Prints disk statistics. */
 void
 disk_print_stats (void) {
@@ -166,13 +302,57 @@ disk_print_stats (void) {
 
 		for (dev_no = 0; dev_no < 2; dev_no++) {
 			struct disk *d = disk_get (chan_no, dev_no);
-			if (d != NULL && d->is_ata)
-				printf ("%s: %lld reads, %lld writes\n",
-						d->name, d->read_cnt, d->write_cnt);
+			struct diskstat s;
+			uint64_t avg_depth;
+
+			if (d == NULL)
+				continue;
+			disk_stats (d, &s);
+			printf ("%s: %lld reads, %lld writes\n",
+					d->name, s.read_cnt, s.write_cnt);
+			if (s.requests == 0 || s.completed == 0)
+				continue;
+
+			avg_depth = s.depth_sum * 100 / s.requests;
+			printf ("%s: %"PRIu64" requests, %"PRIu64"%% sequential, "
+					"queue depth %"PRIu64".%02"PRIu64" avg, %"PRIu32" max\n",
+					d->name, s.requests, s.sequential * 100 / s.requests,
+					avg_depth / 100, avg_depth % 100, s.max_depth);
+			printf ("%s: %"PRIu64" cycles avg wait, %"PRIu64" cycles avg service\n",
+					d->name, s.wait_cycles / s.completed,
+					s.service_cycles / s.completed);
+			print_histogram (d->name, "wait", s.wait_hist);
+			print_histogram (d->name, "service", s.service_hist);
 		}
 	}
 }
 
+/* Prints the nonempty buckets of histogram HIST, labeled with
+   disk NAME and WHAT it measures. */
+static void
+print_histogram (const char *name, const char *what,
+		const uint64_t hist[DISKSTAT_BUCKETS]) {
+	int i;
+
+	printf ("%s: %s cycles:", name, what);
+	for (i = 0; i < DISKSTAT_BUCKETS; i++)
+		if (hist[i] != 0)
+			printf (" 2^%d:%"PRIu64, i, hist[i]);
+	printf ("\n");
+}
+
+/* Copies disk D's statistics into *S. */
+void
+disk_stats (struct disk *d, struct diskstat *s) {
+	enum intr_level old_level;
+
+	ASSERT (d != NULL);
+
+	old_level = intr_disable ();
+	*s = d->stats;
+	intr_set_level (old_level);
+}
+
 /* Returns the disk numbered DEV_NO--either 0 or 1 for master or
    slave, respectively--within the channel numbered CHAN_NO.
 
@@ -181,6 +361,7 @@ disk_print_stats (void) {
 0:1 - file system
 1:0 - scratch
 1:1 - swap
+2:0 - second swap disk, if any (virtio only)
 */
 struct disk *
 disk_get (int chan_no, int dev_no) {
@@ -188,7 +369,7 @@ disk_get (int chan_no, int dev_no) {
 
 	if (chan_no < (int) CHANNEL_CNT) {
 		struct disk *d = &channels[chan_no].devices[dev_no];
-		if (d->is_ata)
+		if (d->is_ata || d->vblk != NULL)
 			return d;
 	}
 	return NULL;
@@ -209,21 +390,7 @@ disk_size (struct disk *d) {
    per-disk locking is unneeded. */
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
-	struct channel *c;
-
-	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
-
-	c = d->channel;
-	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-	sema_down (&c->completion_wait);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-	input_sector (c, buffer);
-	d->read_cnt++;
-	lock_release (&c->lock);
+	disk_read_multiple (d, sec_no, 1, buffer);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -233,21 +400,31 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
    per-disk locking is unneeded. */
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
-	struct channel *c;
+	disk_write_multiple (d, sec_no, 1, buffer);
+}
 
+/* Reads CNT consecutive sectors starting at SEC_NO from disk D
+   into BUFFER, which must have room for CNT * DISK_SECTOR_SIZE
+   bytes.  Uses as few commands as possible. */
+void
+disk_read_multiple (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		void *buffer) {
 	ASSERT (d != NULL);
 	ASSERT (buffer != NULL);
 
-	c = d->channel;
-	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-	output_sector (c, buffer);
-	sema_down (&c->completion_wait);
-	d->write_cnt++;
-	lock_release (&c->lock);
+	submit_and_wait (d, sec_no, cnt, buffer, false);
+}
+
+/* Writes CNT consecutive sectors starting at SEC_NO to disk D
+   from BUFFER, which must contain CNT * DISK_SECTOR_SIZE bytes.
+   Returns after the disk has acknowledged receiving the data. */
+void
+disk_write_multiple (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		const void *buffer) {
+	ASSERT (d != NULL);
+	ASSERT (buffer != NULL);
+
+	submit_and_wait (d, sec_no, cnt, (void *) buffer, true);
 }
 
 /* Disk detection and identification. */
@@ -361,8 +538,20 @@ identify_ata_device (struct disk *d) {
 	}
 	input_sector (c, id);
 
-	/* Calculate capacity. */
-	d->capacity = id[60] | ((uint32_t) id[61] << 16);
+	/* Calculate capacity.  Word 83 bit 10 says the device supports
+	   LBA48, in which case words 100...103 give the full size;
+	   words 60...61 stop at 2**28 sectors.  We cannot address past
+	   the range of disk_sector_t, so larger disks are clipped. */
+	d->lba48 = (id[83] & 0x0400) != 0;
+	if (d->lba48) {
+		uint64_t capacity = id[100] | ((uint64_t) id[101] << 16)
+			| ((uint64_t) id[102] << 32) | ((uint64_t) id[103] << 48);
+		d->capacity = capacity > UINT32_MAX ? UINT32_MAX : capacity;
+	} else
+		d->capacity = id[60] | ((uint32_t) id[61] << 16);
+
+	/* Word 49 bit 8: DMA supported. */
+	d->dma = (id[49] & 0x0100) != 0;
 
 	/* Print identification message. */
 	printf ("%s: detected %'"PRDSNu" sector (", d->name, d->capacity);
@@ -402,22 +591,41 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
-static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+   writes SEC_NO and the sector count CNT to the disk's sector
+   selection registers.  (We use LBA mode.)  Returns true if the
+   sectors lie beyond LBA28's reach, so that the caller must issue
+   an EXT command; otherwise the cheaper LBA28 form is used. */
+static bool
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
+	uint64_t lba = sec_no;
+	bool ext = lba + cnt > LBA28_SECTORS;
 
-	ASSERT (sec_no < d->capacity);
-	ASSERT (sec_no < (1UL << 28));
+	ASSERT (cnt >= 1 && cnt <= MAX_XFER_SECTORS);
+	ASSERT (sec_no < d->capacity && cnt <= d->capacity - sec_no);
+	ASSERT (!ext || d->lba48);
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
-	outb (reg_lbal (c), sec_no);
-	outb (reg_lbam (c), sec_no >> 8);
-	outb (reg_lbah (c), (sec_no >> 16));
-	outb (reg_device (c),
-			DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0) | (sec_no >> 24));
+	if (ext) {
+		outb (reg_nsect (c), cnt >> 8);
+		outb (reg_lbal (c), lba >> 24);
+		outb (reg_lbam (c), lba >> 32);
+		outb (reg_lbah (c), lba >> 40);
+		outb (reg_nsect (c), cnt);
+		outb (reg_lbal (c), lba);
+		outb (reg_lbam (c), lba >> 8);
+		outb (reg_lbah (c), lba >> 16);
+		outb (reg_device (c),
+				DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0));
+	} else {
+		outb (reg_nsect (c), cnt == MAX_XFER_SECTORS ? 0 : cnt);
+		outb (reg_lbal (c), lba);
+		outb (reg_lbam (c), lba >> 8);
+		outb (reg_lbah (c), lba >> 16);
+		outb (reg_device (c),
+				DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0) | (lba >> 24));
+	}
+	return ext;
 }
 
 /* Writes COMMAND to channel C and prepares for receiving a
@@ -446,6 +654,479 @@ output_sector (struct channel *c, const void *sector) {
 	outsw (reg_data (c), sector, DISK_SECTOR_SIZE / 2);
 }
 
+/* Transfers the CNT sectors starting at SEC_NO of disk D in PIO
+   mode, one interrupt per sector.  The data is spread over the
+   SEG_CNT pieces in SEGS. */
+static void
+pio_transfer (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		const struct segment *segs, size_t seg_cnt, bool write) {
+	struct channel *c = d->channel;
+	size_t i, j;
+	bool ext;
+
+	ext = select_sector (d, sec_no, cnt);
+	if (write)
+		issue_pio_command (c, ext ? CMD_WRITE_SECTOR_EXT : CMD_WRITE_SECTOR_RETRY);
+	else
+		issue_pio_command (c, ext ? CMD_READ_SECTOR_EXT : CMD_READ_SECTOR_RETRY);
+	for (i = 0; i < seg_cnt; i++)
+		for (j = 0; j < segs[i].cnt; j++, sec_no++) {
+			uint8_t *sector = segs[i].buffer + j * DISK_SECTOR_SIZE;
+
+			if (!write) {
+				sema_down (&c->completion_wait);
+				if (!wait_while_busy (d))
+					PANIC ("%s: disk read failed, sector=%"PRDSNu,
+							d->name, sec_no);
+				input_sector (c, sector);
+			} else {
+				if (!wait_while_busy (d))
+					PANIC ("%s: disk write failed, sector=%"PRDSNu,
+							d->name, sec_no);
+				output_sector (c, sector);
+				sema_down (&c->completion_wait);
+			}
+		}
+}
+
+/* Returns true if the SIZE bytes at BUFFER can be the target of a
+   DMA transfer: kernel memory (which is mapped at KERN_BASE plus
+   its physical address), word aligned, below 4 GB. */
+static bool
+dma_addressable (const void *buffer, size_t size) {
+	return is_kernel_vaddr (buffer)
+		&& ((uintptr_t) buffer & 1) == 0
+		&& vtop (buffer) + size <= 0x100000000ULL;
+}
+
+/* Fills channel C's PRD table to describe the SEG_CNT pieces in
+   SEGS, splitting at 64 kB boundaries. */
+static void
+build_prdt (struct channel *c, const struct segment *segs, size_t seg_cnt) {
+	struct prd *prd = c->prdt;
+	size_t i;
+
+	for (i = 0; i < seg_cnt; i++) {
+		uint64_t pa = vtop (segs[i].buffer);
+		size_t size = segs[i].cnt * DISK_SECTOR_SIZE;
+
+		while (size > 0) {
+			size_t chunk = 0x10000 - (pa & 0xffff);
+			if (chunk > size)
+				chunk = size;
+			prd->addr = pa;
+			prd->size = chunk & 0xffff;
+			prd->flags = 0;
+			prd++;
+			pa += chunk;
+			size -= chunk;
+		}
+	}
+	prd[-1].flags = PRD_EOT;
+}
+
+/* Transfers the CNT sectors starting at SEC_NO of disk D by bus
+   master DMA, scattered over the SEG_CNT pieces in SEGS, sleeping
+   until the completion interrupt.  Every piece must satisfy
+   dma_addressable().  Returns false if the controller or the
+   device reported an error. */
+static bool
+dma_transfer (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		const struct segment *segs, size_t seg_cnt, bool write) {
+	struct channel *c = d->channel;
+	uint8_t direction = write ? 0 : BM_CMD_READ;
+	bool ext;
+
+	build_prdt (c, segs, seg_cnt);
+	outl (reg_bm_prdt (c), vtop (c->prdt));
+	outb (reg_bm_command (c), direction);
+	outb (reg_bm_status (c), BM_STA_ERROR | BM_STA_INTR);
+
+	ext = select_sector (d, sec_no, cnt);
+	c->dma_active = true;
+	if (write)
+		issue_pio_command (c, ext ? CMD_WRITE_DMA_EXT : CMD_WRITE_DMA);
+	else
+		issue_pio_command (c, ext ? CMD_READ_DMA_EXT : CMD_READ_DMA);
+	barrier ();
+	outb (reg_bm_command (c), direction | BM_CMD_START);
+	sema_down (&c->completion_wait);
+	c->dma_active = false;
+
+	if ((c->bm_status & BM_STA_ERROR) || (inb (reg_alt_status (c)) & STA_ERR)) {
+		printf ("%s: DMA failed, sector=%"PRDSNu", using PIO\n",
+				d->name, sec_no);
+		d->dma = false;
+		return false;
+	}
+	return true;
+}
+
+/* Returns true if transfers to and from disk D use DMA. */
+static bool
+use_dma (const struct disk *d) {
+	return d->channel->bm_base != 0 && d->dma;
+}
+
+/* Transfers the CNT sectors starting at SEC_NO of disk D to or
+   from BUFFER, splitting into as few commands as possible.
+   Uses DMA if use_dma(), through the channel's bounce buffer if
+   BUFFER cannot be used directly, and PIO otherwise. */
+static void
+transfer (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		void *buffer_, bool write) {
+	struct channel *c = d->channel;
+	uint8_t *buffer = buffer_;
+
+	while (cnt > 0) {
+		struct segment seg;
+		bool done = false;
+
+		seg.buffer = buffer;
+		seg.cnt = cnt < MAX_XFER_SECTORS ? cnt : MAX_XFER_SECTORS;
+		if (use_dma (d)) {
+			if (!dma_addressable (buffer, seg.cnt * DISK_SECTOR_SIZE)) {
+				/* Go through the bounce buffer. */
+				struct segment bounce = { c->bounce, seg.cnt };
+				size_t size;
+
+				if (bounce.cnt > BOUNCE_SECTORS)
+					bounce.cnt = seg.cnt = BOUNCE_SECTORS;
+				size = seg.cnt * DISK_SECTOR_SIZE;
+				if (write)
+					memcpy (c->bounce, buffer, size);
+				done = dma_transfer (d, sec_no, seg.cnt, &bounce, 1, write);
+				if (done && !write)
+					memcpy (buffer, c->bounce, size);
+			} else
+				done = dma_transfer (d, sec_no, seg.cnt, &seg, 1, write);
+		}
+		if (!done)
+			pio_transfer (d, sec_no, seg.cnt, &seg, 1, write);
+
+		sec_no += seg.cnt;
+		buffer += seg.cnt * DISK_SECTOR_SIZE;
+		cnt -= seg.cnt;
+	}
+}
+
+/* Request queue.
+
+   All transfers go through a per-channel queue served by a worker
+   thread, so callers may submit requests and carry on while the
+   channel works.  The queue is kept sorted by (device, sector) and
+   served in C-LOOK order: the worker sweeps upward from the last
+   sector it served and then wraps around to the lowest pending
+   request.  Requests that continue where the one being served
+   ends, in the same direction, are merged into a single command
+   whose data is scattered over the requests' buffers. */
+
+/* Most requests merged into one command. */
+#define MAX_MERGE 32
+
+/* Returns true if request A sorts before request B. */
+static bool
+request_less (const struct list_elem *a_, const struct list_elem *b_,
+		void *aux UNUSED) {
+	const struct disk_request *a = list_entry (a_, struct disk_request, elem);
+	const struct disk_request *b = list_entry (b_, struct disk_request, elem);
+
+	if (a->disk != b->disk)
+		return a->disk->dev_no < b->disk->dev_no;
+	return a->sec_no < b->sec_no;
+}
+
+/* Queues request R.  R's DONE function is called from the channel's
+   worker thread once R has completed; R must stay allocated until
+   then.  R's buffer must be in kernel memory, because the worker
+   runs without the submitter's page tables.  Requests for
+   overlapping sectors are not ordered with respect to each other. */
+void
+disk_submit (struct disk_request *r) {
+	struct channel *c;
+	struct diskstat *s;
+	enum intr_level old_level;
+
+	ASSERT (r != NULL && r->disk != NULL && r->buffer != NULL);
+	ASSERT (is_kernel_vaddr (r->buffer));
+	ASSERT (r->cnt > 0 && r->sec_no < r->disk->capacity
+			&& r->cnt <= r->disk->capacity - r->sec_no);
+	ASSERT (!intr_context ());
+
+	r->submit_time = rdtsc ();
+	old_level = intr_disable ();
+	s = &r->disk->stats;
+	if (r->write)
+		s->write_cnt += r->cnt;
+	else
+		s->read_cnt += r->cnt;
+	if (r->sec_no == r->disk->next_sec)
+		s->sequential++;
+	r->disk->next_sec = r->sec_no + r->cnt;
+	s->requests++;
+	s->depth++;
+	if (s->depth > s->max_depth)
+		s->max_depth = s->depth;
+	s->depth_sum += s->depth;
+	intr_set_level (old_level);
+
+	if (r->disk->vblk != NULL) {
+		vblk_submit (r->disk->vblk, r);
+		return;
+	}
+
+	c = r->disk->channel;
+	lock_acquire (&c->queue_lock);
+	list_insert_ordered (&c->queue, &r->elem, request_less, NULL);
+	cond_signal (&c->queue_cond, &c->queue_lock);
+	lock_release (&c->queue_lock);
+}
+
+/* Removes the next C-LOOK request from C's queue, along with the
+   requests that can be merged into it, and stores them in BATCH.
+   Returns the number of requests stored.  C's queue must not be
+   empty and its queue_lock must be held. */
+static size_t
+next_batch (struct channel *c, struct disk_request *batch[MAX_MERGE]) {
+	struct disk_request *r = NULL, *first;
+	struct list_elem *e;
+	disk_sector_t next;
+	size_t cnt, sectors;
+	bool dma;
+
+	/* Lowest request at or above the head, else wrap around. */
+	for (e = list_begin (&c->queue); e != list_end (&c->queue);
+			e = list_next (e)) {
+		r = list_entry (e, struct disk_request, elem);
+		if (r->disk->dev_no > c->head_dev
+				|| (r->disk->dev_no == c->head_dev && r->sec_no >= c->head_sec))
+			break;
+	}
+	if (e == list_end (&c->queue))
+		e = list_begin (&c->queue);
+
+	first = list_entry (e, struct disk_request, elem);
+	dma = use_dma (first->disk);
+	batch[0] = first;
+	cnt = 1;
+	sectors = first->cnt;
+	next = first->sec_no + first->cnt;
+	e = list_remove (e);
+
+	/* Merge the requests that follow it on disk. */
+	if (first->cnt <= MAX_XFER_SECTORS
+			&& (!dma || dma_addressable (first->buffer,
+					first->cnt * DISK_SECTOR_SIZE)))
+		while (e != list_end (&c->queue) && cnt < MAX_MERGE) {
+			r = list_entry (e, struct disk_request, elem);
+			if (r->disk != first->disk || r->write != first->write
+					|| r->sec_no != next
+					|| sectors + r->cnt > MAX_XFER_SECTORS
+					|| (dma && !dma_addressable (r->buffer,
+							r->cnt * DISK_SECTOR_SIZE)))
+				break;
+			batch[cnt++] = r;
+			sectors += r->cnt;
+			next += r->cnt;
+			e = list_remove (e);
+		}
+
+	c->head_dev = first->disk->dev_no;
+	c->head_sec = next;
+	return cnt;
+}
+
+/* Carries out the CNT requests in BATCH, which next_batch()
+   picked, as a single command if more than one. */
+static void
+execute_batch (struct disk_request *batch[MAX_MERGE], size_t cnt) {
+	struct disk_request *first = batch[0];
+	struct disk *d = first->disk;
+	size_t i, sectors = 0;
+
+	if (cnt == 1)
+		transfer (d, first->sec_no, first->cnt, first->buffer, first->write);
+	else {
+		struct segment segs[MAX_MERGE];
+
+		for (i = 0; i < cnt; i++) {
+			segs[i].buffer = batch[i]->buffer;
+			segs[i].cnt = batch[i]->cnt;
+			sectors += batch[i]->cnt;
+		}
+		if (!use_dma (d)
+				|| !dma_transfer (d, first->sec_no, sectors, segs, cnt,
+					first->write))
+			pio_transfer (d, first->sec_no, sectors, segs, cnt, first->write);
+	}
+}
+
+/* Worker thread for channel C_: serves C_'s queue forever. */
+static void
+channel_worker (void *c_) {
+	struct channel *c = c_;
+
+	for (;;) {
+		struct disk_request *batch[MAX_MERGE];
+		size_t cnt, i;
+
+		lock_acquire (&c->queue_lock);
+		while (list_empty (&c->queue))
+			cond_wait (&c->queue_cond, &c->queue_lock);
+		cnt = next_batch (c, batch);
+		lock_release (&c->queue_lock);
+
+		lock_acquire (&c->lock);
+		for (i = 0; i < cnt; i++)
+			disk_started (batch[i]);
+		execute_batch (batch, cnt);
+		lock_release (&c->lock);
+
+		for (i = 0; i < cnt; i++)
+			disk_complete (batch[i]);
+	}
+}
+
+/* Returns the histogram bucket for a latency of CYCLES. */
+static int
+histogram_bucket (uint64_t cycles) {
+	int bucket = cycles != 0 ? 63 - __builtin_clzll (cycles) : 0;
+	return bucket < DISKSTAT_BUCKETS ? bucket : DISKSTAT_BUCKETS - 1;
+}
+
+/* Called by the driver as it hands request R to the device. */
+void
+disk_started (struct disk_request *r) {
+	r->start_time = rdtsc ();
+}
+
+/* Called by the driver, in thread context, when request R has
+   finished.  Accounts for R and then calls its DONE function. */
+void
+disk_complete (struct disk_request *r) {
+	uint64_t now = rdtsc ();
+	uint64_t wait = r->start_time - r->submit_time;
+	uint64_t service = now - r->start_time;
+	struct diskstat *s = &r->disk->stats;
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	s->depth--;
+	s->completed++;
+	s->wait_cycles += wait;
+	s->service_cycles += service;
+	s->wait_hist[histogram_bucket (wait)]++;
+	s->service_hist[histogram_bucket (service)]++;
+	intr_set_level (old_level);
+
+	r->done (r, r->aux);
+}
+
+/* DONE function for the synchronous wrappers: wakes the waiter. */
+static void
+wake_waiter (struct disk_request *r UNUSED, void *sema) {
+	sema_up (sema);
+}
+
+/* Submits a request to move CNT sectors between SEC_NO on disk D
+   and BUFFER and waits for it to complete.  A user BUFFER is
+   copied through kernel pages here, in the caller's context,
+   since the worker cannot see it. */
+static void
+submit_and_wait (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		void *buffer, bool write) {
+	size_t page_cnt = DIV_ROUND_UP (cnt * DISK_SECTOR_SIZE, PGSIZE);
+	uint8_t sector[DISK_SECTOR_SIZE];
+	uint8_t *bounce, *ubuf = buffer;
+	size_t chunk, i;
+
+	if (is_kernel_vaddr (buffer)) {
+		submit_one (d, sec_no, cnt, buffer, write);
+		return;
+	}
+
+	/* Bounce the whole transfer if the pages are there, otherwise a
+	   page or, failing that, a sector at a time. */
+	chunk = cnt;
+	bounce = palloc_get_multiple (0, page_cnt);
+	if (bounce == NULL) {
+		page_cnt = 1;
+		chunk = PGSIZE / DISK_SECTOR_SIZE;
+		bounce = palloc_get_page (0);
+	}
+	if (bounce == NULL) {
+		page_cnt = 0;
+		chunk = 1;
+		bounce = sector;
+	}
+
+	for (i = 0; i < cnt; i += chunk) {
+		size_t n = cnt - i < chunk ? cnt - i : chunk;
+		uint8_t *ub = ubuf + i * DISK_SECTOR_SIZE;
+
+		if (write)
+			memcpy (bounce, ub, n * DISK_SECTOR_SIZE);
+		submit_one (d, sec_no + i, n, bounce, write);
+		if (!write)
+			memcpy (ub, bounce, n * DISK_SECTOR_SIZE);
+	}
+	if (page_cnt > 0)
+		palloc_free_multiple (bounce, page_cnt);
+}
+
+/* Submits a request to move CNT sectors between SEC_NO on disk D
+   and kernel BUFFER and waits for it to complete. */
+static void
+submit_one (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		void *buffer, bool write) {
+	struct semaphore done;
+	struct disk_request r;
+
+	sema_init (&done, 0);
+	r.disk = d;
+	r.sec_no = sec_no;
+	r.cnt = cnt;
+	r.buffer = buffer;
+	r.write = write;
+	r.done = wake_waiter;
+	r.aux = &done;
+	disk_submit (&r);
+	sema_down (&done);
+}
+
+/* Looks for a PCI IDE controller that can be a bus master and,
+   if there is one, enables DMA on the channels it serves.  Any
+   failure just leaves the channels in PIO mode. */
+static void
+setup_dma (void) {
+	struct pci_dev ide;
+	uint16_t bm_base;
+	size_t chan_no;
+
+	/* Class 1 (mass storage), subclass 1 (IDE); bit 7 of the
+	   programming interface says it can be a bus master. */
+	if (!pci_find_class (0x01, 0x01, 0, &ide)
+			|| !(pci_read8 (&ide, PCI_PROG_IF) & 0x80))
+		return;
+	bm_base = pci_io_bar (&ide, 4);
+	if (bm_base == 0)
+		return;
+	pci_enable (&ide, PCI_CMD_IO | PCI_CMD_MASTER);
+
+	for (chan_no = 0; chan_no < ATA_CHANNEL_CNT; chan_no++) {
+		struct channel *c = &channels[chan_no];
+
+		c->prdt = palloc_get_page (0);
+		c->bounce = palloc_get_page (0);
+		if (c->prdt == NULL || c->bounce == NULL) {
+			palloc_free_page (c->prdt);
+			palloc_free_page (c->bounce);
+			continue;
+		}
+		c->bm_base = bm_base + 8 * chan_no;
+	}
+}
+
 /* Low-level ATA primitives. */
 
 /* Wait up to 10 seconds for the controller to become idle, that
@@ -519,6 +1200,12 @@ interrupt_handler (struct intr_frame *f) {
 	for (c = channels; c < channels + CHANNEL_CNT; c++)
 		if (f->vec_no == c->irq) {
 			if (c->expecting_interrupt) {
+				if (c->dma_active) {
+					/* Stop the bus master and clear its status. */
+					c->bm_status = inb (reg_bm_status (c));
+					outb (reg_bm_command (c), 0);
+					outb (reg_bm_status (c), BM_STA_ERROR | BM_STA_INTR);
+				}
 				inb (reg_status (c));               /* Acknowledge interrupt. */
 				sema_up (&c->completion_wait);      /* Wake up waiter. */
 			} else
@@ -532,13 +1219,13 @@ interrupt_handler (struct intr_frame *f) {
 static void
 inspect_read_cnt (struct intr_frame *f) {
 	struct disk * d = disk_get (f->R.rdx, f->R.rcx);
-	f->R.rax = d->read_cnt;
+	f->R.rax = d->stats.read_cnt;
 }
 
 static void
 inspect_write_cnt (struct intr_frame *f) {
 	struct disk * d = disk_get (f->R.rdx, f->R.rcx);
-	f->R.rax = d->write_cnt;
+	f->R.rax = d->stats.write_cnt;
 }
 
 /* Tool for testing disk r/w cnt. Calling this function via int 0x43 and int 0x44.
@@ -1,15 +1,39 @@
 #include "devices/input.h"
+#include <console.h>
 #include <debug.h>
+#include <stdio.h>
+#include <string.h>
 #include "devices/intq.h"
 #include "devices/serial.h"
+#include "threads/synch.h"
 
 /* Stores keys from the keyboard and serial port. */
 static struct intq buffer;
 
+/* Serializes input_read() callers. */
+static struct lock read_lock;
+
+/* Line discipline, enabled by the -icanon kernel option.  Input
+   is collected a line at a time, with echo and backspace
+   editing, and read() returns at most one line. */
+static bool canonical;
+#define LINE_MAX 256
+static char line[LINE_MAX];     /* Line being edited or read. */
+static size_t line_len;         /* Bytes in LINE. */
+static size_t line_ofs;         /* Bytes of a finished LINE already read. */
+static bool line_done;          /* True once LINE is finished. */
+
 /* Initializes the input buffer. */
 void
 input_init (void) {
 	intq_init (&buffer);
+	lock_init_named (&read_lock, "input_read");
+}
+
+/* Turns the line discipline on. */
+void
+input_set_canonical (void) {
+	canonical = true;
 }
 
 /* Adds a key to the input buffer.
@@ -38,6 +62,92 @@ input_getc (void) {
 	return key;
 }
 
+/* Moves up to SIZE keys that are already in the input buffer
+   into DST, without waiting.  Returns the number moved. */
+static size_t
+take_available (uint8_t *dst, size_t size) {
+	size_t n = 0;
+
+	while (n < size) {
+		enum intr_level old_level;
+		uint8_t chunk[64];
+		size_t cnt = 0;
+
+		/* Empty the queue in chunks with interrupts off, copying
+		   out with them on, since DST may be user memory. */
+		old_level = intr_disable ();
+		while (cnt < sizeof chunk && cnt < size - n && !intq_empty (&buffer))
+			chunk[cnt++] = intq_getc (&buffer);
+		serial_notify ();
+		intr_set_level (old_level);
+
+		memcpy (dst + n, chunk, cnt);
+		n += cnt;
+		if (cnt < sizeof chunk)
+			break;
+	}
+	return n;
+}
+
+/* Reads keys into LINE until it holds a whole line, echoing them
+   and handling backspace.  A ^D at the start of a line finishes
+   an empty line, which read() reports as end of file. */
+static void
+read_line (void) {
+	line_len = line_ofs = 0;
+	for (;;) {
+		uint8_t c = input_getc ();
+
+		if (c == '\r')
+			c = '\n';
+		if (c == '\b' || c == 0x7f) {
+			if (line_len > 0) {
+				line_len--;
+				putbuf ("\b \b", 3);
+			}
+		} else if (c == 0x04) {
+			if (line_len == 0)
+				break;
+		} else {
+			line[line_len++] = c;
+			putchar (c);
+			if (c == '\n' || line_len == LINE_MAX)
+				break;
+		}
+	}
+	line_done = true;
+}
+
+/* Reads up to SIZE bytes of input into DST_ and returns the
+   number read.  Waits for the first byte and then takes whatever
+   else has already arrived, or, with the line discipline, at most
+   the rest of the current line.  Returns 0 at end of file. */
+size_t
+input_read (void *dst_, size_t size) {
+	uint8_t *dst = dst_;
+	size_t n;
+
+	if (size == 0)
+		return 0;
+
+	lock_acquire (&read_lock);
+	if (canonical) {
+		if (!line_done)
+			read_line ();
+		n = line_len - line_ofs < size ? line_len - line_ofs : size;
+		memcpy (dst, line + line_ofs, n);
+		line_ofs += n;
+		if (line_ofs == line_len)
+			line_done = false;
+	} else {
+		dst[0] = input_getc ();
+		n = 1 + take_available (dst + 1, size - 1);
+	}
+	lock_release (&read_lock);
+
+	return n;
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
@@ -0,0 +1,129 @@
+#include "devices/pci.h"
+#include <debug.h>
+#include "threads/io.h"
+
+/* PCI configuration space access through the legacy I/O ports
+   ("configuration mechanism #1").  Only what the disk drivers
+   need: reading and writing configuration registers and finding
+   a function by class or by vendor and device ID. */
+
+#define PCI_CONFIG_ADDRESS 0xcf8        /* Selects a register. */
+#define PCI_CONFIG_DATA 0xcfc           /* Reads or writes it. */
+
+/* Selects register REG of function P and returns the data port
+   to access it through. */
+static uint16_t
+select_reg (const struct pci_dev *p, uint8_t reg) {
+	outl (PCI_CONFIG_ADDRESS, 0x80000000u | (p->bus << 16) | (p->dev << 11)
+			| (p->func << 8) | (reg & 0xfc));
+	return PCI_CONFIG_DATA + (reg & 3);
+}
+
+/* Reads the 32-bit register REG of P. */
+uint32_t
+pci_read32 (const struct pci_dev *p, uint8_t reg) {
+	ASSERT (reg % 4 == 0);
+	return inl (select_reg (p, reg));
+}
+
+/* Reads the 16-bit register REG of P. */
+uint16_t
+pci_read16 (const struct pci_dev *p, uint8_t reg) {
+	ASSERT (reg % 2 == 0);
+	return inw (select_reg (p, reg));
+}
+
+/* Reads the 8-bit register REG of P. */
+uint8_t
+pci_read8 (const struct pci_dev *p, uint8_t reg) {
+	return inb (select_reg (p, reg));
+}
+
+/* Writes VALUE to the 32-bit register REG of P. */
+void
+pci_write32 (const struct pci_dev *p, uint8_t reg, uint32_t value) {
+	ASSERT (reg % 4 == 0);
+	outl (select_reg (p, reg), value);
+}
+
+/* Writes VALUE to the 16-bit register REG of P. */
+void
+pci_write16 (const struct pci_dev *p, uint8_t reg, uint16_t value) {
+	ASSERT (reg % 2 == 0);
+	outw (select_reg (p, reg), value);
+}
+
+/* Finds the INDEX'th (counting from 0) PCI function that
+   MATCH accepts, given A and B, and stores its location in *P.
+   Returns true if found. */
+static bool
+scan (bool (*match) (const struct pci_dev *, uint32_t, uint32_t),
+		uint32_t a, uint32_t b, int index, struct pci_dev *p) {
+	int bus, dev, func;
+
+	for (bus = 0; bus < 256; bus++)
+		for (dev = 0; dev < 32; dev++)
+			for (func = 0; func < 8; func++) {
+				struct pci_dev cand = { bus, dev, func };
+
+				if (pci_read16 (&cand, PCI_VENDOR_ID) == 0xffff) {
+					if (func == 0)
+						break;
+					continue;
+				}
+				if (match (&cand, a, b) && index-- == 0) {
+					*p = cand;
+					return true;
+				}
+				/* Single-function devices only decode function 0. */
+				if (func == 0
+						&& !(pci_read8 (&cand, PCI_HEADER_TYPE) & 0x80))
+					break;
+			}
+	return false;
+}
+
+static bool
+match_class (const struct pci_dev *p, uint32_t class, uint32_t subclass) {
+	return pci_read8 (p, PCI_CLASS) == class
+		&& pci_read8 (p, PCI_SUBCLASS) == subclass;
+}
+
+static bool
+match_id (const struct pci_dev *p, uint32_t vendor, uint32_t device) {
+	return pci_read16 (p, PCI_VENDOR_ID) == vendor
+		&& pci_read16 (p, PCI_DEVICE_ID) == device;
+}
+
+/* Finds the INDEX'th function with the given CLASS and SUBCLASS
+   and stores its location in *P.  Returns true if found. */
+bool
+pci_find_class (uint8_t class, uint8_t subclass, int index,
+		struct pci_dev *p) {
+	return scan (match_class, class, subclass, index, p);
+}
+
+/* Finds the INDEX'th function with the given VENDOR and DEVICE ID
+   and stores its location in *P.  Returns true if found. */
+bool
+pci_find_device (uint16_t vendor, uint16_t device, int index,
+		struct pci_dev *p) {
+	return scan (match_id, vendor, device, index, p);
+}
+
+/* Returns the I/O port base of P's base address register BAR, or
+   0 if BAR is unset or maps memory rather than I/O ports. */
+uint16_t
+pci_io_bar (const struct pci_dev *p, int bar) {
+	uint32_t value = pci_read32 (p, PCI_BAR0 + 4 * bar);
+
+	if (!(value & 1))
+		return 0;
+	return value & ~3u;
+}
+
+/* Sets CMD_BITS in P's command register. */
+void
+pci_enable (const struct pci_dev *p, uint16_t cmd_bits) {
+	pci_write16 (p, PCI_COMMAND, pci_read16 (p, PCI_COMMAND) | cmd_bits);
+}
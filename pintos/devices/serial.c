@@ -1,7 +1,7 @@
 #include "devices/serial.h"
 #include <debug.h>
+#include <string.h>
 #include "devices/input.h"
-#include "devices/intq.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
@@ -33,6 +33,11 @@
 #define MCR_REG (IO_BASE + 4)   /* MODEM Control Register. */
 #define LSR_REG (IO_BASE + 5)   /* Line Status Register (read-only). */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable receive and transmit FIFOs. */
+#define FCR_CLEAR_RECV 0x02     /* Clear receive FIFO. */
+#define FCR_CLEAR_XMIT 0x04     /* Clear transmit FIFO. */
+
 /* Interrupt Enable Register bits. */
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
@@ -46,19 +51,51 @@
 
 /* Line Status Register. */
 #define LSR_DR 0x01             /* Data Ready: received data byte is in RBR. */
-#define LSR_THRE 0x20           /* THR Empty. */
+#define LSR_THRE 0x20           /* THR Empty (with FIFOs: FIFO empty). */
+
+/* Bytes the 16550A transmit FIFO holds. */
+#define FIFO_SIZE 16
 
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
-static struct intq txq;
+/* Data to be transmitted, a ring buffer indexed by free-running
+   counters.  Writers only copy into it; the transmit interrupt
+   drains it a FIFO's worth at a time.  Accessed with interrupts
+   off. */
+#define TXQ_SIZE 16384
+static uint8_t txq[TXQ_SIZE];
+static size_t txq_head;         /* Total bytes queued. */
+static size_t txq_tail;         /* Total bytes sent. */
+
+/* Bytes we may still write to THR without checking LSR: the
+   room left in the transmit FIFO when we last saw it empty. */
+static int fifo_room;
+
+/* Current contents of IER, so that unchanged values need not be
+   written again. */
+static uint8_t ier;
 
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
+static void xmit_burst (void);
 static void write_ier (void);
 static intr_handler_func serial_interrupt;
 
+/* Returns the number of bytes waiting in txq. */
+static size_t
+txq_cnt (void) {
+	return txq_head - txq_tail;
+}
+
+/* Removes and returns the oldest byte in txq, which must not be
+   empty. */
+static uint8_t
+txq_getc (void) {
+	ASSERT (txq_cnt () > 0);
+	return txq[txq_tail++ % TXQ_SIZE];
+}
+
 /* Initializes the serial port device for polling mode.
    Polling mode busy-waits for the serial port to become free
    before writing to it.  It's slow, but until interrupts have
@@ -67,10 +104,11 @@ static void
 init_poll (void) {
 	ASSERT (mode == UNINIT);
 	outb (IER_REG, 0);                    /* Turn off all interrupts. */
-	outb (FCR_REG, 0);                    /* Disable FIFO. */
+	ier = 0;
+	outb (FCR_REG, FCR_ENABLE | FCR_CLEAR_RECV | FCR_CLEAR_XMIT);
 	set_serial (115200);                  /* 115.2 kbps, N-8-1. */
 	outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-	intq_init (&txq);
+	fifo_room = 0;
 	mode = POLL;
 }
 
@@ -95,27 +133,45 @@ serial_init_queue (void) {
 /* Sends BYTE to the serial port. */
 void
 serial_putc (uint8_t byte) {
+	serial_putbuf (&byte, 1);
+}
+
+/* Sends the N bytes in BUFFER to the serial port.  Once the port
+   is interrupt-driven this only queues them, and returns without
+   waiting for the port unless the queue is full. */
+void
+serial_putbuf (const void *buffer, size_t n) {
+	const uint8_t *p = buffer;
 	enum intr_level old_level = intr_disable ();
 
 	if (mode != QUEUE) {
 		/* If we're not set up for interrupt-driven I/O yet,
-		   use dumb polling to transmit a byte. */
+		   use dumb polling to transmit. */
 		if (mode == UNINIT)
 			init_poll ();
-		putc_poll (byte);
+		while (n-- > 0)
+			putc_poll (*p++);
 	} else {
-		/* Otherwise, queue a byte and update the interrupt enable
-		   register. */
-		if (old_level == INTR_OFF && intq_full (&txq)) {
-			/* Interrupts are off and the transmit queue is full.
-			   If we wanted to wait for the queue to empty,
-			   we'd have to reenable interrupts.
-			   That's impolite, so we'll send a character via
-			   polling instead. */
-			putc_poll (intq_getc (&txq));
+		while (n > 0) {
+			size_t ofs = txq_head % TXQ_SIZE;
+			size_t chunk = TXQ_SIZE - txq_cnt ();
+
+			if (chunk == 0) {
+				/* The queue is full.  Waiting for it to drain would
+				   mean turning interrupts back on, which may not be
+				   ours to do, so make room by polling instead. */
+				putc_poll (txq_getc ());
+				continue;
+			}
+			if (chunk > TXQ_SIZE - ofs)
+				chunk = TXQ_SIZE - ofs;
+			if (chunk > n)
+				chunk = n;
+			memcpy (txq + ofs, p, chunk);
+			txq_head += chunk;
+			p += chunk;
+			n -= chunk;
 		}
-
-		intq_putc (&txq, byte);
 		write_ier ();
 	}
 
@@ -127,8 +183,8 @@ serial_putc (uint8_t byte) {
 void
 serial_flush (void) {
 	enum intr_level old_level = intr_disable ();
-	while (!intq_empty (&txq))
-		putc_poll (intq_getc (&txq));
+	while (txq_cnt () > 0)
+		putc_poll (txq_getc ());
 	intr_set_level (old_level);
 }
 
@@ -162,35 +218,57 @@ set_serial (int bps) {
 	outb (LCR_REG, LCR_N81);
 }
 
-/* Update interrupt enable register. */
+/* Update interrupt enable register, if it changes.  Turning on
+   the transmit interrupt while the FIFO is empty raises an
+   interrupt right away, which starts transmission. */
 static void
 write_ier (void) {
-	uint8_t ier = 0;
+	uint8_t new_ier = 0;
 
 	ASSERT (intr_get_level () == INTR_OFF);
 
 	/* Enable transmit interrupt if we have any characters to
 	   transmit. */
-	if (!intq_empty (&txq))
-		ier |= IER_XMIT;
+	if (txq_cnt () > 0)
+		new_ier |= IER_XMIT;
 
 	/* Enable receive interrupt if we have room to store any
 	   characters we receive. */
 	if (!input_full ())
-		ier |= IER_RECV;
+		new_ier |= IER_RECV;
 
-	outb (IER_REG, ier);
+	if (new_ier != ier) {
+		ier = new_ier;
+		outb (IER_REG, ier);
+	}
 }
 
 /* Polls the serial port until it's ready,
-   and then transmits BYTE. */
+   and then transmits BYTE.  Checks the port only once per
+   FIFO_SIZE bytes. */
 static void
 putc_poll (uint8_t byte) {
 	ASSERT (intr_get_level () == INTR_OFF);
 
-	while ((inb (LSR_REG) & LSR_THRE) == 0)
-		continue;
+	if (fifo_room == 0) {
+		while ((inb (LSR_REG) & LSR_THRE) == 0)
+			continue;
+		fifo_room = FIFO_SIZE;
+	}
 	outb (THR_REG, byte);
+	fifo_room--;
+}
+
+/* If the transmit FIFO is empty, refills it from txq. */
+static void
+xmit_burst (void) {
+	int n;
+
+	if (txq_cnt () == 0 || (inb (LSR_REG) & LSR_THRE) == 0)
+		return;
+	for (n = 0; n < FIFO_SIZE && txq_cnt () > 0; n++)
+		outb (THR_REG, txq_getc ());
+	fifo_room = FIFO_SIZE - n;
 }
 
 /* Serial interrupt handler. */
@@ -205,10 +283,9 @@ serial_interrupt (struct intr_frame *f UNUSED) {
 	while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
 		input_putc (inb (RBR_REG));
 
-	/* As long as we have a byte to transmit, and the hardware is
-	   ready to accept a byte for transmission, transmit a byte. */
-	while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0)
-		outb (THR_REG, intq_getc (&txq));
+	/* If the hardware is ready to accept bytes for transmission,
+	   fill its FIFO. */
+	xmit_burst ();
 
 	/* Update interrupt enable register based on queue status. */
 	write_ier ();
@@ -5,6 +5,7 @@
 #include <round.h>
 #include <stdio.h>
 
+#include "intrinsic.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/synch.h"
@@ -19,32 +20,127 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
+/* 8254 input frequency, and the count that makes one timer tick
+   of it, rounded to nearest. */
+#define PIT_HZ 1193180
+#define TICK_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Most ticks a single one-shot countdown can span, since the
+   8254 counter is 16 bits wide. */
+#define MAX_ONESHOT_TICKS (0xffff / TICK_COUNT)
+
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Tickless idle.  While only the idle thread can run, the PIT is
+   switched from periodic mode to a single countdown that ends
+   when the next sleeper is due, and the ticks it spans are added
+   up when it ends or when something else wakes the CPU first.
+   ONESHOT_TICKS is the number of ticks the running countdown
+   stands for, 0 in periodic mode, and ONESHOT_COUNT its length in
+   PIT counts. */
+static int64_t oneshot_ticks;
+static uint16_t oneshot_count;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Nanosecond clock.  timer_calibrate() counts TSC cycles across
+   CALIBRATE_TICKS timer ticks; timer_ns() then scales the cycles
+   since TSC_BASE, which was read NS_BASE ns after boot.  TSC_HZ is
+   0 until then. */
+#define NS_PER_SEC 1000000000
+#define CALIBRATE_TICKS (TIMER_FREQ / 10 > 0 ? TIMER_FREQ / 10 : 1)
+static uint64_t tsc_hz;
+static uint64_t tsc_base;
+static int64_t ns_base;
+
+/* Sub-tick sleeps.  Threads that sleep for less than a tick wait
+   on HR_SLEEP_LIST, ordered by wake_ns, while the MC146818 RTC
+   interrupts RTC_HZ times per second; its periodic interrupt is
+   turned on only while the list is non-empty.  Sleeps shorter
+   than one RTC period spin on the TSC instead. */
+#define CMOS_ADDR 0x70
+#define CMOS_DATA 0x71
+#define RTC_REG_A 0x0a   /* Divider and rate select. */
+#define RTC_REG_B 0x0b   /* Interrupt enables. */
+#define RTC_REG_C 0x0c   /* Interrupt flags, cleared by reading. */
+#define RTC_B_PIE 0x40   /* Periodic interrupt enable. */
+#define RTC_RATE 3       /* 32768 >> (RTC_RATE - 1) = 8192 Hz. */
+#define RTC_HZ (32768 >> (RTC_RATE - 1))
+#define RTC_PERIOD_NS (NS_PER_SEC / RTC_HZ)
+static struct list hr_sleep_list;
+static bool rtc_ticking;
+
+/* Profiling samples, taken every SAMPLE_DIV RTC interrupts while
+   SAMPLE_FUNC is set.  The RTC then never stops. */
+static timer_sample_func *sample_func;
+static int sample_div;
+static int sample_countdown;
+
+/* Timer wheel holding every armed struct timer_event, as in
+   [Varghese 1987].  Level 0 has one slot per tick for the next
+   WHEEL_SIZE ticks; each slot of level L covers WHEEL_SIZE**L
+   ticks, and is moved down ("cascaded") a level when the level
+   below wraps around.  Insertion and cancellation are O(1), and
+   each timer is cascaded at most WHEEL_LEVELS - 1 times.  Timers
+   further away than the top level can reach are parked in its
+   last slot and re-inserted when it cascades.  WHEEL_NOW is the
+   next tick the wheel has yet to run. */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN(LEVEL) (1LL << (WHEEL_BITS * (LEVEL)))
+static struct list wheel[WHEEL_LEVELS][WHEEL_SIZE];
+static int64_t wheel_now;
+
 static intr_handler_func timer_interrupt;
+static intr_handler_func rtc_interrupt;
+static uint8_t cmos_read(uint8_t reg);
+static void cmos_write(uint8_t reg, uint8_t val);
+static void hr_sleep(int64_t deadline);
+static bool wake_ns_less(const struct list_elem *a, const struct list_elem *b, void *aux);
+static void wheel_insert(struct timer_event *e);
+static void wheel_run(int64_t now);
+static int64_t wheel_quiet_ticks(int64_t max);
+static void wake_sleeper(struct timer_event *e);
 static bool too_many_loops(unsigned loops);
 static void busy_wait(int64_t loops);
 static void real_time_sleep(int64_t num, int32_t denom);
-static bool wake_tick_less(const struct list_elem *a, const struct list_elem *b, void *aux);
+
+/* Programs the PIT to interrupt TIMER_FREQ times per second. */
+static void pit_periodic(void) {
+  outb(0x43, 0x34); /* CW: counter 0, LSB then MSB, mode 2, binary. */
+  outb(0x40, TICK_COUNT & 0xff);
+  outb(0x40, TICK_COUNT >> 8);
+}
+
+/* Programs the PIT to interrupt once, COUNT PIT counts from now. */
+static void pit_oneshot(uint16_t count) {
+  outb(0x43, 0x30); /* CW: counter 0, LSB then MSB, mode 0, binary. */
+  outb(0x40, count & 0xff);
+  outb(0x40, count >> 8);
+}
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
    corresponding interrupt. */
 void timer_init(void) {
-  /* 8254 input frequency divided by TIMER_FREQ, rounded to
-     nearest. */
-  uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
+  pit_periodic();
+  intr_register_ext(0x20, timer_interrupt, "8254 Timer");
 
-  outb(0x43, 0x34); /* CW: counter 0, LSB then MSB, mode 2, binary. */
-  outb(0x40, count & 0xff);
-  outb(0x40, count >> 8);
+  for (int level = 0; level < WHEEL_LEVELS; level++)
+    for (int slot = 0; slot < WHEEL_SIZE; slot++) list_init(&wheel[level][slot]);
+  wheel_now = ticks + 1;
 
-  intr_register_ext(0x20, timer_interrupt, "8254 Timer");
+  /* RTC는 주기만 설정해 두고, sub-tick으로 자는 쓰레드가 있을 때만 인터럽트를 켠다. */
+  list_init(&hr_sleep_list);
+  cmos_write(RTC_REG_A, (cmos_read(RTC_REG_A) & 0xf0) | RTC_RATE);
+  cmos_write(RTC_REG_B, cmos_read(RTC_REG_B) & ~RTC_B_PIE);
+  cmos_read(RTC_REG_C);
+  intr_register_ext(0x28, rtc_interrupt, "RTC");
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -68,6 +164,38 @@ void timer_calibrate(void) {
     if (!too_many_loops(high_bit | test_bit)) loops_per_tick |= test_bit;
 
   printf("%'" PRIu64 " loops/s.\n", (uint64_t)loops_per_tick * TIMER_FREQ);
+
+  /* Count TSC cycles across CALIBRATE_TICKS ticks.  One tick is
+     TICK_COUNT PIT counts, not exactly 1/TIMER_FREQ seconds. */
+  int64_t start = ticks;
+  while (ticks == start) barrier();
+  uint64_t tsc0 = rdtsc();
+  start = ticks;
+  while (ticks - start < CALIBRATE_TICKS) barrier();
+  uint64_t cycles = rdtsc() - tsc0;
+
+  tsc_base = tsc0;
+  ns_base = start * (NS_PER_SEC / TIMER_FREQ);
+  tsc_hz = cycles * PIT_HZ / ((uint64_t)CALIBRATE_TICKS * TICK_COUNT);
+  printf("TSC runs at %'" PRIu64 " Hz.\n", tsc_hz);
+}
+
+/* Returns the number of nanoseconds since the OS booted, measured
+   with the TSC.  Before timer_calibrate() has run, only tick
+   resolution is available. */
+int64_t timer_ns(void) {
+  if (tsc_hz == 0) return timer_ticks() * (NS_PER_SEC / TIMER_FREQ);
+  return timer_tsc_to_ns(rdtsc());
+}
+
+/* Converts TSC, a value read with rdtsc() after timer_calibrate(),
+   to nanoseconds since the OS booted, on the timer_ns() clock. */
+int64_t timer_tsc_to_ns(uint64_t tsc) {
+  ASSERT(tsc_hz != 0);
+
+  /* 곱셈 overflow를 피하려고 몫과 나머지를 따로 환산한다. */
+  uint64_t cycles = tsc - tsc_base;
+  return ns_base + cycles / tsc_hz * NS_PER_SEC + cycles % tsc_hz * NS_PER_SEC / tsc_hz;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -93,14 +221,12 @@ void timer_sleep(int64_t ticks) {
   // 현제 스레드 가져오기
   struct thread *curr = thread_current();
 
-  // wake_tick 설정
-  curr->wake_tick = start + ticks;
-
   // 인터럽트 끄기
   enum intr_level old_level = intr_disable();
 
-  // sleep_list에 추가
-  list_insert_ordered(get_sleep_list(), &curr->sleep_elem, wake_tick_less, NULL);
+  // start + ticks에 깨우도록 타이머 등록
+  timer_event_init(&curr->sleep_timer, wake_sleeper, curr);
+  timer_add(&curr->sleep_timer, start + ticks);
 
   // thread_block() 호출, 재 schedule 될 때까지 대기
   thread_block();
@@ -118,23 +244,209 @@ void timer_usleep(int64_t us) { real_time_sleep(us, 1000 * 1000); }
 /* Suspends execution for approximately NS nanoseconds. */
 void timer_nsleep(int64_t ns) { real_time_sleep(ns, 1000 * 1000 * 1000); }
 
+/* Initializes timer E to call FUNC, which can find AUX in
+   E->aux.  E is not armed. */
+void timer_event_init(struct timer_event *e, timer_event_func *func, void *aux) {
+  ASSERT(e != NULL && func != NULL);
+  e->func = func;
+  e->aux = aux;
+  e->pending = false;
+}
+
+/* Arms timer E to fire at the first timer tick at or after
+   DEADLINE, or at the next tick if DEADLINE has passed.  E must
+   not be armed already.  E's function is called with interrupts
+   off, from the timer interrupt handler, so it must not sleep. */
+void timer_add(struct timer_event *e, int64_t deadline) {
+  ASSERT(!e->pending);
+
+  enum intr_level old_level = intr_disable();
+  e->deadline = deadline;
+  e->pending = true;
+  wheel_insert(e);
+  intr_set_level(old_level);
+}
+
+/* Disarms timer E.  Returns true if E was armed, false if it had
+   already fired (or was never armed). */
+bool timer_cancel(struct timer_event *e) {
+  enum intr_level old_level = intr_disable();
+  bool pending = e->pending;
+  if (pending) {
+    list_remove(&e->elem);
+    e->pending = false;
+  }
+  intr_set_level(old_level);
+  return pending;
+}
+
+/* Puts E in the wheel slot that will bring it to level 0 in time
+   for its deadline. */
+static void wheel_insert(struct timer_event *e) {
+  int64_t delta = e->deadline - wheel_now;
+  int64_t when = e->deadline;
+  int level;
+
+  if (delta < 0) {  // 이미 지난 deadline이면 다음 tick에 실행
+    delta = 0;
+    when = wheel_now;
+  } else if (delta >= WHEEL_SPAN(WHEEL_LEVELS)) {  // 너무 먼 미래는 맨 위 level의 끝에 두었다가 다시 넣는다
+    delta = WHEEL_SPAN(WHEEL_LEVELS) - 1;
+    when = wheel_now + delta;
+  }
+
+  for (level = 0; delta >= WHEEL_SPAN(level + 1); level++) continue;
+  list_push_back(&wheel[level][(when >> (WHEEL_BITS * level)) & WHEEL_MASK], &e->elem);
+}
+
+/* Runs the wheel through tick NOW, cascading timers down as each
+   level wraps and firing those whose deadline has come.  Ticks
+   skipped by the idle countdown are run one by one; their slots
+   are empty. */
+static void wheel_run(int64_t now) {
+  while (wheel_now <= now) {
+    int64_t t = wheel_now;
+
+    /* level 0이 한 바퀴 돌 때마다 윗 level의 slot 하나를 아래로 내린다. */
+    for (int level = 1; level < WHEEL_LEVELS && (t & (WHEEL_SPAN(level) - 1)) == 0; level++) {
+      struct list *slot = &wheel[level][(t >> (WHEEL_BITS * level)) & WHEEL_MASK];
+      while (!list_empty(slot)) wheel_insert(list_entry(list_pop_front(slot), struct timer_event, elem));
+    }
+    wheel_now++;
+
+    struct list *slot = &wheel[0][t & WHEEL_MASK];
+    while (!list_empty(slot)) {
+      struct timer_event *e = list_entry(list_pop_front(slot), struct timer_event, elem);
+      e->pending = false;
+      e->func(e);
+    }
+  }
+}
+
+/* Returns how many ticks, at most MAX, can pass before the wheel
+   has work to do: a timer firing or a level cascading.  Only the
+   level-0 slots need checking, because nothing reaches level 0
+   without a cascade. */
+static int64_t wheel_quiet_ticks(int64_t max) {
+  int64_t n;
+  if (wheel_now <= ticks) return 1;  // idle 중에 건너뛴 tick을 아직 따라잡지 못했다
+  for (n = 1; n < max; n++) {
+    int64_t t = ticks + n;
+    if ((t & WHEEL_MASK) == 0 || !list_empty(&wheel[0][t & WHEEL_MASK])) break;
+  }
+  return n;
+}
+
+/* Timer function for timer_sleep(). */
+static void wake_sleeper(struct timer_event *e) { thread_unblock(e->aux); }
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  Replaces the periodic tick by a countdown to the next
+   timer, if that is more than a tick away. */
+void timer_idle_enter(void) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  timer_idle_exit();  // 이전 countdown 중에 다른 인터럽트로 깨어났다면 지난 시간부터 반영
+  if (oneshot_ticks != 0) return;
+
+  int64_t n = wheel_quiet_ticks(MAX_ONESHOT_TICKS);
+  /* MLFQS의 1초 단위 계산(load_avg 등)을 건너뛰지 않도록 초 경계에서 끊는다. */
+  if (thread_mlfqs && n > TIMER_FREQ - ticks % TIMER_FREQ) n = TIMER_FREQ - ticks % TIMER_FREQ;
+  if (n <= 1) return;
+
+  oneshot_ticks = n;
+  oneshot_count = n * TICK_COUNT;
+  pit_oneshot(oneshot_count);
+}
+
+/* Called with interrupts off when the CPU stops being idle, and
+   by timer_idle_enter().  If a countdown is running, adds the
+   whole ticks that have passed to the tick count and shortens the
+   countdown to the next tick boundary, after which the timer
+   interrupt restores the periodic tick. */
+void timer_idle_exit(void) {
+  ASSERT(intr_get_level() == INTR_OFF);
+  if (oneshot_ticks == 0) return;
+
+  outb(0x43, 0xc2); /* Read-back: latch status and count of counter 0. */
+  uint8_t status = inb(0x40);
+  uint16_t remaining = inb(0x40);
+  remaining |= inb(0x40) << 8;
+
+  /* OUT이 high면 이미 끝났고 타이머 인터럽트가 대기 중이다.
+     null count면 아직 카운트가 로드되지 않았으므로 흐른 시간이 없다. */
+  if (status & 0xc0) return;
+
+  uint16_t elapsed = oneshot_count - remaining;
+  int64_t whole = elapsed / TICK_COUNT;
+  ticks += whole;
+  thread_account_idle(whole);
+
+  oneshot_ticks = 1;
+  oneshot_count = TICK_COUNT - elapsed % TICK_COUNT;
+  pit_oneshot(oneshot_count);
+}
+
+/* Starts calling FUNC from the RTC interrupt about HZ times per
+   second, for sampling profilers.  Returns the actual rate, which
+   is RTC_HZ divided by a whole number.  Sampling cannot be
+   stopped. */
+int timer_start_sampling(timer_sample_func *func, int hz) {
+  ASSERT(func != NULL);
+  ASSERT(hz > 0);
+
+  enum intr_level old_level = intr_disable();
+  sample_div = hz < RTC_HZ ? RTC_HZ / hz : 1;
+  sample_countdown = sample_div;
+  sample_func = func;
+  if (!rtc_ticking) {
+    cmos_write(RTC_REG_B, cmos_read(RTC_REG_B) | RTC_B_PIE);
+    rtc_ticking = true;
+  }
+  intr_set_level(old_level);
+  return RTC_HZ / sample_div;
+}
+
+/* Blocks the running thread until timer_ns() reaches DEADLINE,
+   for sleeps shorter than a tick. */
+static void hr_sleep(int64_t deadline) {
+  if (deadline - timer_ns() < RTC_PERIOD_NS) {
+    // RTC 한 주기보다 짧으면 블록하는 것보다 기다리는 편이 정확하다
+    while (timer_ns() < deadline) barrier();
+    return;
+  }
+
+  struct thread *curr = thread_current();
+  curr->wake_ns = deadline;
+
+  enum intr_level old_level = intr_disable();
+  list_insert_ordered(&hr_sleep_list, &curr->sleep_elem, wake_ns_less, NULL);
+  if (!rtc_ticking) {
+    cmos_write(RTC_REG_B, cmos_read(RTC_REG_B) | RTC_B_PIE);
+    rtc_ticking = true;
+  }
+  thread_block();
+  intr_set_level(old_level);
+}
+
 /* Prints timer statistics. */
 void timer_print_stats(void) { printf("Timer: %" PRId64 " ticks\n", timer_ticks()); }
 
 /* Timer interrupt handler. */
 static void timer_interrupt(struct intr_frame *args UNUSED) {
+  if (oneshot_ticks != 0) {
+    /* A countdown ended.  It stood for ONESHOT_TICKS ticks, all but
+       this last one spent idle; go back to the periodic tick. */
+    ticks += oneshot_ticks - 1;
+    thread_account_idle(oneshot_ticks - 1);
+    oneshot_ticks = 0;
+    pit_periodic();
+  }
   ticks++;
   thread_tick();
 
-  // 잠든 쓰레드를 깨우자
-  while (!list_empty(get_sleep_list())) {
-    struct thread *sleep_thread = list_entry(list_front(get_sleep_list()), struct thread, sleep_elem);
-    if (sleep_thread->wake_tick > ticks)  // wake_tick이 흐른 시간보다 크다면, 아직 깨울 때가 아님
-      break;
-    //깨울 때라면
-    list_pop_front(get_sleep_list());
-    thread_unblock(sleep_thread);
-  }
+  // 시간이 된 타이머들을 실행 (잠든 쓰레드 깨우기 포함)
+  wheel_run(ticks);
 
   /* recent_cpu 증가 */
   if (thread_mlfqs) {  // mlqfs일 때만
@@ -147,17 +459,55 @@ static void timer_interrupt(struct intr_frame *args UNUSED) {
     if (ticks % 4 == 0) {
       // 원래 모든 쓰레드를 순회해야하지만, 어짜피 바뀐건 현재쓰레드의 recent_cpu밖에 없다.
       mlfqs_update_priority(thread_current());
-      if (thread_current()->priority <= max_priority_mlfqs_queue()) {
+      if (thread_current()->priority <= max_ready_priority()) {
         intr_yield_on_return();  // 핸들러 내부이므로 핸들러끝나고 yield
       }
     }
-    /* load_avg 최신화 */
+    /* load_avg 최신화, recent_cpu 감쇠는 쓰레드마다 나중에 반영 */
     if (ticks % TIMER_FREQ == 0) {  // 1초 마다
       thread_update_load_avg();
-      thread_update_all_recent_cpu();
-      thread_update_all_priority();
+      thread_mlfqs_new_second();
     }
+    thread_mlfqs_refresh();  // 지난 초에 머문 ready 쓰레드 몇 개씩 최신화
+  }
+}
+
+/* RTC periodic interrupt handler.  Takes a profiling sample if
+   one is due, wakes the sub-tick sleepers whose deadline has
+   passed, and stops the interrupt once neither needs it. */
+static void rtc_interrupt(struct intr_frame *args) {
+  cmos_read(RTC_REG_C);  // 읽어야 다음 인터럽트가 온다
+
+  if (sample_func != NULL && --sample_countdown == 0) {
+    sample_countdown = sample_div;
+    sample_func(args);
   }
+
+  int64_t now = timer_ns();
+  while (!list_empty(&hr_sleep_list)) {
+    struct thread *t = list_entry(list_front(&hr_sleep_list), struct thread, sleep_elem);
+    if (t->wake_ns > now) break;
+    list_pop_front(&hr_sleep_list);
+    thread_unblock(t);
+  }
+
+  if (list_empty(&hr_sleep_list) && rtc_ticking && sample_func == NULL) {
+    cmos_write(RTC_REG_B, cmos_read(RTC_REG_B) & ~RTC_B_PIE);
+    rtc_ticking = false;
+  }
+}
+
+/* Reads CMOS register REG.  Setting bit 7 of the address keeps
+   NMIs masked while we do. */
+static uint8_t cmos_read(uint8_t reg) {
+  outb(CMOS_ADDR, 0x80 | reg);
+  return inb(CMOS_DATA);
+}
+
+/* Writes VAL to CMOS register REG. */
+static void cmos_write(uint8_t reg, uint8_t val) {
+  outb(CMOS_ADDR, 0x80 | reg);
+  outb(CMOS_DATA, val);
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -203,6 +553,10 @@ static void real_time_sleep(int64_t num, int32_t denom) {
        timer_sleep() because it will yield the CPU to other
        processes. */
     timer_sleep(ticks);
+  } else if (tsc_hz != 0) {
+    /* Less than a tick.  Block until the TSC clock says we are
+       done; the RTC wakes us with sub-millisecond precision. */
+    hr_sleep(timer_ns() + num * (NS_PER_SEC / denom));
   } else {
     /* Otherwise, use a busy-wait loop for more accurate
        sub-tick timing.  We scale the numerator and denominator
@@ -212,9 +566,9 @@ static void real_time_sleep(int64_t num, int32_t denom) {
   }
 }
 
-static bool wake_tick_less(const struct list_elem *a, const struct list_elem *b, void *aux) {
+static bool wake_ns_less(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED) {
   struct thread *thread_a = list_entry(a, struct thread, sleep_elem);
   struct thread *thread_b = list_entry(b, struct thread, sleep_elem);
 
-  return thread_a->wake_tick < thread_b->wake_tick;
+  return thread_a->wake_ns < thread_b->wake_ns;
 }
\ No newline at end of file
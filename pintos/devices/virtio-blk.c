@@ -0,0 +1,386 @@
+#include "devices/virtio-blk.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/pci.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* A driver for legacy ("transitional") virtio block devices, as
+   described in [Virtio 0.9.5].  QEMU provides them with
+   "-device virtio-blk-pci,disable-modern=on".
+
+   Unlike the ATA path, where every sector costs several port
+   accesses, a whole batch of requests is described in memory and
+   announced to the device with a single port write. */
+
+/* PCI identification. */
+#define VIRTIO_VENDOR 0x1af4
+#define VIRTIO_BLK_DEVICE 0x1001        /* Legacy block device. */
+
+/* Legacy virtio registers, as offsets from the I/O BAR.  The
+   device-specific registers start at 0x14 because we do not
+   enable MSI-X. */
+#define REG_DEVICE_FEATURES 0x00        /* 32 bits (r/o). */
+#define REG_GUEST_FEATURES 0x04         /* 32 bits. */
+#define REG_QUEUE_PFN 0x08              /* 32 bits. */
+#define REG_QUEUE_SIZE 0x0c             /* 16 bits (r/o). */
+#define REG_QUEUE_SELECT 0x0e           /* 16 bits. */
+#define REG_QUEUE_NOTIFY 0x10           /* 16 bits. */
+#define REG_STATUS 0x12                 /* 8 bits. */
+#define REG_ISR 0x13                    /* 8 bits, cleared on read. */
+#define REG_CAPACITY 0x14               /* 64 bits (r/o), in sectors. */
+
+/* Device status bits. */
+#define STATUS_ACKNOWLEDGE 0x01         /* Guest noticed the device. */
+#define STATUS_DRIVER 0x02              /* Guest can drive it. */
+#define STATUS_DRIVER_OK 0x04           /* Driver is ready. */
+#define STATUS_FAILED 0x80              /* Guest gave up. */
+
+/* ISR bits. */
+#define ISR_QUEUE 0x01                  /* A used ring was updated. */
+
+/* A split virtqueue: a descriptor table, the "available" ring,
+   through which we hand descriptor chains to the device, and the
+   "used" ring, through which the device hands them back.  The
+   used ring starts on a page boundary. */
+struct vring_desc {
+	uint64_t addr;                      /* Physical address. */
+	uint32_t len;                       /* Length in bytes. */
+	uint16_t flags;                     /* VRING_DESC_F_*. */
+	uint16_t next;                      /* Next in chain, if F_NEXT. */
+};
+#define VRING_DESC_F_NEXT 0x1           /* Chain continues in NEXT. */
+#define VRING_DESC_F_WRITE 0x2          /* Device writes the buffer. */
+
+struct vring_avail {
+	uint16_t flags;
+	uint16_t idx;                       /* Where we put the next entry. */
+	uint16_t ring[];                    /* Heads of descriptor chains. */
+};
+
+struct vring_used_elem {
+	uint32_t id;                        /* Head of a completed chain. */
+	uint32_t len;                       /* Bytes written by the device. */
+};
+
+struct vring_used {
+	uint16_t flags;
+	uint16_t idx;                       /* Where the device puts the next. */
+	struct vring_used_elem ring[];
+};
+#define VRING_USED_F_NO_NOTIFY 0x1      /* Device asks not to be kicked. */
+
+/* Every block request is a chain of three descriptors: this
+   header, the data, and a status byte written by the device. */
+struct vblk_header {
+	uint32_t type;                      /* VBLK_T_*. */
+	uint32_t reserved;
+	uint64_t sector;                    /* First sector. */
+};
+#define VBLK_T_IN 0                     /* Read. */
+#define VBLK_T_OUT 1                    /* Write. */
+#define VBLK_S_OK 0                     /* Status: success. */
+
+/* Descriptors per request. */
+#define DESC_PER_REQ 3
+
+/* Most requests in flight on one device. */
+#define MAX_SLOTS 64
+
+/* A request in flight.  Slot N owns descriptors N * DESC_PER_REQ
+   and the two after it. */
+struct vblk_slot {
+	struct vblk_header header;
+	uint8_t status;
+	struct disk_request *r;
+};
+
+/* A virtio block device. */
+struct vblk {
+	char name[8];                       /* Name, e.g. "vd1". */
+	struct pci_dev pci;                 /* Where it is on the bus. */
+	uint16_t io_base;                   /* Base of the I/O BAR. */
+	uint8_t irq;                        /* Interrupt vector. */
+	disk_sector_t capacity;             /* Size in sectors. */
+
+	/* Virtqueue 0.  Only the worker thread touches these. */
+	uint16_t queue_size;                /* Entries in the rings. */
+	size_t queue_pages;                 /* Pages holding the rings. */
+	struct vring_desc *desc;
+	struct vring_avail *avail;
+	volatile struct vring_used *used;
+	uint16_t last_used;                 /* used->idx already reaped. */
+	struct vblk_slot *slots;            /* One page of slots. */
+	uint8_t free_slots[MAX_SLOTS];      /* Stack of free slot numbers. */
+	size_t free_cnt;                    /* Entries in free_slots. */
+
+	struct lock lock;                   /* Protects PENDING. */
+	struct list pending;                /* disk_requests not yet started. */
+	struct semaphore wake;              /* Up'd on new work. */
+};
+
+/* Devices found, by probe order. */
+#define VBLK_MAX 6
+static struct vblk devices[VBLK_MAX];
+static size_t device_cnt;
+
+static bool setup_device (struct vblk *);
+static void vblk_worker (void *);
+static void interrupt_handler (struct intr_frame *);
+
+/* Finds the virtio block devices on the PCI bus, sets them up
+   and starts a worker thread for each. */
+void
+vblk_init (void) {
+	int index;
+
+	for (index = 0; device_cnt < VBLK_MAX; index++) {
+		struct vblk *v = &devices[device_cnt];
+		struct pci_dev pci;
+		size_t i;
+
+		if (!pci_find_device (VIRTIO_VENDOR, VIRTIO_BLK_DEVICE, index, &pci))
+			break;
+		v->pci = pci;
+		snprintf (v->name, sizeof v->name, "vd%zu", device_cnt);
+		if (!setup_device (v))
+			continue;
+
+		/* Devices on the same line share one handler. */
+		for (i = 0; i < device_cnt; i++)
+			if (devices[i].irq == v->irq)
+				break;
+		if (i == device_cnt)
+			intr_register_ext (v->irq, interrupt_handler, "virtio-blk");
+
+		lock_init_named (&v->lock, "virtio_blk");
+		list_init (&v->pending);
+		sema_init (&v->wake, 0);
+		device_cnt++;
+		if (thread_create (v->name, PRI_MAX, vblk_worker, v) == TID_ERROR)
+			PANIC ("%s: can't create worker thread", v->name);
+
+		printf ("%s: virtio-blk at PCI slot %#x, %"PRDSNu" sectors\n",
+				v->name, pci.dev, v->capacity);
+	}
+}
+
+/* Returns the device that stands in for disk DISK_NO, that is,
+   the one in PCI slot VBLK_PCI_SLOT + DISK_NO, or a null pointer
+   if there is none. */
+struct vblk *
+vblk_get (int disk_no) {
+	size_t i;
+
+	for (i = 0; i < device_cnt; i++)
+		if (devices[i].pci.dev == VBLK_PCI_SLOT + disk_no)
+			return &devices[i];
+	return NULL;
+}
+
+/* Returns the size of V in sectors. */
+disk_sector_t
+vblk_capacity (const struct vblk *v) {
+	return v->capacity;
+}
+
+/* Queues request R on V.  Called through disk_submit(), which
+   has checked R. */
+void
+vblk_submit (struct vblk *v, struct disk_request *r) {
+	lock_acquire (&v->lock);
+	list_push_back (&v->pending, &r->elem);
+	lock_release (&v->lock);
+	sema_up (&v->wake);
+}
+
+/* Resets V and brings it up with a single virtqueue, as in
+   section 3.1 of [Virtio 0.9.5].  Returns false, leaving V
+   unused, on failure. */
+static bool
+setup_device (struct vblk *v) {
+	uint8_t line;
+	uint64_t capacity;
+	size_t used_ofs, i;
+	uint8_t *queue;
+
+	v->io_base = pci_io_bar (&v->pci, 0);
+	line = pci_read8 (&v->pci, PCI_INTERRUPT_LINE);
+	/* Lines 0...4, 8 and 14...15 belong to devices we already
+	   drive. */
+	if (v->io_base == 0 || line <= 4 || line == 8 || line >= 14) {
+		printf ("%s: unusable I/O port or IRQ, ignoring\n", v->name);
+		return false;
+	}
+	v->irq = line + 0x20;
+	pci_enable (&v->pci, PCI_CMD_IO | PCI_CMD_MASTER);
+
+	/* Reset, then say hello.  We want none of the optional
+	   features. */
+	outb (v->io_base + REG_STATUS, 0);
+	outb (v->io_base + REG_STATUS, STATUS_ACKNOWLEDGE);
+	outb (v->io_base + REG_STATUS, STATUS_ACKNOWLEDGE | STATUS_DRIVER);
+	outl (v->io_base + REG_GUEST_FEATURES, 0);
+
+	/* Lay out queue 0 in physically contiguous pages. */
+	outw (v->io_base + REG_QUEUE_SELECT, 0);
+	v->queue_size = inw (v->io_base + REG_QUEUE_SIZE);
+	used_ofs = ROUND_UP (sizeof *v->desc * v->queue_size
+			+ sizeof *v->avail + sizeof (uint16_t) * (v->queue_size + 1),
+			PGSIZE);
+	v->queue_pages = DIV_ROUND_UP (used_ofs + sizeof *v->used
+			+ sizeof (struct vring_used_elem) * v->queue_size
+			+ sizeof (uint16_t), PGSIZE);
+	queue = (v->queue_size >= DESC_PER_REQ
+			? palloc_get_multiple (PAL_ZERO, v->queue_pages) : NULL);
+	v->slots = palloc_get_page (PAL_ZERO);
+	if (queue == NULL || v->slots == NULL) {
+		printf ("%s: can't set up virtqueue\n", v->name);
+		if (queue != NULL)
+			palloc_free_multiple (queue, v->queue_pages);
+		palloc_free_page (v->slots);
+		outb (v->io_base + REG_STATUS, STATUS_FAILED);
+		return false;
+	}
+	v->desc = (struct vring_desc *) queue;
+	v->avail = (struct vring_avail *) (queue
+			+ sizeof *v->desc * v->queue_size);
+	v->used = (struct vring_used *) (queue + used_ofs);
+	v->last_used = 0;
+	outl (v->io_base + REG_QUEUE_PFN, vtop (queue) >> PGBITS);
+
+	v->free_cnt = v->queue_size / DESC_PER_REQ;
+	if (v->free_cnt > MAX_SLOTS)
+		v->free_cnt = MAX_SLOTS;
+	for (i = 0; i < v->free_cnt; i++)
+		v->free_slots[i] = i;
+
+	capacity = inl (v->io_base + REG_CAPACITY)
+		| (uint64_t) inl (v->io_base + REG_CAPACITY + 4) << 32;
+	v->capacity = capacity > UINT32_MAX ? UINT32_MAX : capacity;
+
+	outb (v->io_base + REG_STATUS,
+			STATUS_ACKNOWLEDGE | STATUS_DRIVER | STATUS_DRIVER_OK);
+	return true;
+}
+
+/* Calls the DONE function of every request that V has finished
+   since the last call, and frees their slots. */
+static void
+reap_completed (struct vblk *v) {
+	while (v->last_used != v->used->idx) {
+		struct vblk_slot *s;
+		struct disk_request *r;
+		uint32_t id;
+
+		barrier ();
+		id = v->used->ring[v->last_used % v->queue_size].id;
+		v->last_used++;
+
+		s = &v->slots[id / DESC_PER_REQ];
+		r = s->r;
+		if (s->status != VBLK_S_OK)
+			PANIC ("%s: disk %s failed, sector=%"PRDSNu,
+					v->name, r->write ? "write" : "read", r->sec_no);
+		v->free_slots[v->free_cnt++] = s - v->slots;
+		disk_complete (r);
+	}
+}
+
+/* Describes request R to V in slot S's descriptor chain. */
+static void
+fill_slot (struct vblk *v, size_t s, struct disk_request *r) {
+	struct vblk_slot *slot = &v->slots[s];
+	struct vring_desc *d = &v->desc[s * DESC_PER_REQ];
+	uint16_t head = s * DESC_PER_REQ;
+
+	slot->header.type = r->write ? VBLK_T_OUT : VBLK_T_IN;
+	slot->header.reserved = 0;
+	slot->header.sector = r->sec_no;
+	slot->status = 0xff;
+	slot->r = r;
+	disk_started (r);
+
+	d[0].addr = vtop (&slot->header);
+	d[0].len = sizeof slot->header;
+	d[0].flags = VRING_DESC_F_NEXT;
+	d[0].next = head + 1;
+
+	d[1].addr = vtop (r->buffer);
+	d[1].len = r->cnt * DISK_SECTOR_SIZE;
+	d[1].flags = VRING_DESC_F_NEXT | (r->write ? 0 : VRING_DESC_F_WRITE);
+	d[1].next = head + 2;
+
+	d[2].addr = vtop (&slot->status);
+	d[2].len = 1;
+	d[2].flags = VRING_DESC_F_WRITE;
+	d[2].next = 0;
+}
+
+/* Moves as many pending requests as there are free slots into
+   V's available ring, and then notifies V once for all of them. */
+static void
+start_pending (struct vblk *v) {
+	uint16_t idx = v->avail->idx;
+	uint16_t added = 0;
+
+	lock_acquire (&v->lock);
+	while (!list_empty (&v->pending) && v->free_cnt > 0) {
+		struct disk_request *r = list_entry (list_pop_front (&v->pending),
+				struct disk_request, elem);
+		size_t s = v->free_slots[--v->free_cnt];
+
+		fill_slot (v, s, r);
+		v->avail->ring[(uint16_t) (idx + added) % v->queue_size]
+			= s * DESC_PER_REQ;
+		added++;
+	}
+	lock_release (&v->lock);
+
+	if (added > 0) {
+		/* The device must see the ring entries before the index
+		   that publishes them.  x86 does not reorder stores, so
+		   only the compiler needs restraining. */
+		barrier ();
+		v->avail->idx = idx + added;
+		barrier ();
+		if (!(v->used->flags & VRING_USED_F_NO_NOTIFY))
+			outw (v->io_base + REG_QUEUE_NOTIFY, 0);
+	}
+}
+
+/* Worker thread for device V_: hands queued requests to the
+   device and completes them as the device finishes.  Requests
+   that arrive while the device is busy go out together. */
+static void
+vblk_worker (void *v_) {
+	struct vblk *v = v_;
+
+	for (;;) {
+		sema_down (&v->wake);
+		reap_completed (v);
+		start_pending (v);
+	}
+}
+
+/* Interrupt handler shared by all virtio block devices.  Reading
+   a device's ISR acknowledges its interrupt. */
+static void
+interrupt_handler (struct intr_frame *f) {
+	size_t i;
+
+	for (i = 0; i < device_cnt; i++) {
+		struct vblk *v = &devices[i];
+
+		if (v->irq == f->vec_no
+				&& (inb (v->io_base + REG_ISR) & ISR_QUEUE))
+			sema_up (&v->wake);
+	}
+}
@@ -1,10 +1,13 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include "filesys/fat.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir {
@@ -12,17 +15,184 @@ struct dir {
 	off_t pos;                          /* Current position. */
 };
 
-/* A single directory entry. */
+/* A single directory entry.
+ *
+ * A directory file is an open-addressing hash table of entries: NAME
+ * is stored in slot hash(NAME) % slot count, or in one of the slots
+ * following it.  A slot that has never been used (not in use, empty
+ * name) ends a probe sequence; a removed entry keeps its name as a
+ * tombstone so that probes continue past it. */
 struct dir_entry {
 	disk_sector_t inode_sector;         /* Sector number of header. */
 	char name[NAME_MAX + 1];            /* Null terminated file name. */
 	bool in_use;                        /* In use or free? */
 };
 
+/* Inserting an entry more than this many slots away from its home
+ * slot makes dir_add() try to double the table first. */
+#define DIR_MAX_PROBE 8
+
+/* Smallest table dir_add() grows an empty directory to. */
+#define DIR_MIN_SLOTS 16
+
+/* Lookup cache.
+ * Maps (directory inode sector, name) to the inode sector of the
+ * entry, so repeated lookups of hot names skip the disk entirely.
+ * Entries are evicted in FIFO order once DCACHE_MAX are cached. */
+#define DCACHE_MAX 256
+
+struct dcache_entry {
+	struct hash_elem hash_elem;         /* Element in dcache. */
+	struct list_elem list_elem;         /* Element in dcache_fifo. */
+	disk_sector_t dir_sector;           /* Directory's inode sector. */
+	disk_sector_t inode_sector;         /* Entry's inode sector. */
+	char name[NAME_MAX + 1];            /* Entry's name. */
+};
+
+static struct hash dcache;
+static struct list dcache_fifo;
+static size_t dcache_cnt;
+static struct rwlock dcache_lock;
+
+static uint64_t
+dcache_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct dcache_entry *d = hash_entry (e, struct dcache_entry, hash_elem);
+	return hash_string (d->name) ^ hash_int (d->dir_sector);
+}
+
+static bool
+dcache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct dcache_entry *a = hash_entry (a_, struct dcache_entry, hash_elem);
+	const struct dcache_entry *b = hash_entry (b_, struct dcache_entry, hash_elem);
+	if (a->dir_sector != b->dir_sector)
+		return a->dir_sector < b->dir_sector;
+	return strcmp (a->name, b->name) < 0;
+}
+
+/* Returns the cached entry for NAME in directory DIR_SECTOR, or a
+ * null pointer.  Must be called with dcache_lock held. */
+static struct dcache_entry *
+dcache_find (disk_sector_t dir_sector, const char *name) {
+	struct dcache_entry key;
+	struct hash_elem *e;
+
+	key.dir_sector = dir_sector;
+	strlcpy (key.name, name, sizeof key.name);
+	e = hash_find (&dcache, &key.hash_elem);
+	return e != NULL ? hash_entry (e, struct dcache_entry, hash_elem) : NULL;
+}
+
+/* Removes D from the cache and frees it.
+ * Must be called with dcache_lock held for writing. */
+static void
+dcache_evict (struct dcache_entry *d) {
+	hash_delete (&dcache, &d->hash_elem);
+	list_remove (&d->list_elem);
+	dcache_cnt--;
+	free (d);
+}
+
+/* Looks up NAME in directory DIR_SECTOR in the cache.  On a hit,
+ * stores the entry's inode sector in *INODE_SECTOR and returns true. */
+static bool
+dcache_lookup (disk_sector_t dir_sector, const char *name,
+		disk_sector_t *inode_sector) {
+	struct dcache_entry *d;
+
+	rwlock_acquire_read (&dcache_lock);
+	d = dcache_find (dir_sector, name);
+	if (d != NULL)
+		*inode_sector = d->inode_sector;
+	rwlock_release_read (&dcache_lock);
+	return d != NULL;
+}
+
+/* Records that NAME in directory DIR_SECTOR refers to INODE_SECTOR.
+ * Failing to allocate memory just leaves the entry uncached. */
+static void
+dcache_insert (disk_sector_t dir_sector, const char *name,
+		disk_sector_t inode_sector) {
+	struct dcache_entry *d;
+
+	rwlock_acquire_write (&dcache_lock);
+	d = dcache_find (dir_sector, name);
+	if (d != NULL)
+		d->inode_sector = inode_sector;
+	else if ((d = malloc (sizeof *d)) != NULL) {
+		if (dcache_cnt >= DCACHE_MAX)
+			dcache_evict (list_entry (list_front (&dcache_fifo),
+						struct dcache_entry, list_elem));
+		d->dir_sector = dir_sector;
+		d->inode_sector = inode_sector;
+		strlcpy (d->name, name, sizeof d->name);
+		hash_insert (&dcache, &d->hash_elem);
+		list_push_back (&dcache_fifo, &d->list_elem);
+		dcache_cnt++;
+	}
+	rwlock_release_write (&dcache_lock);
+}
+
+/* Drops the cached entry for NAME in directory DIR_SECTOR, if any. */
+static void
+dcache_remove (disk_sector_t dir_sector, const char *name) {
+	struct dcache_entry *d;
+
+	rwlock_acquire_write (&dcache_lock);
+	d = dcache_find (dir_sector, name);
+	if (d != NULL)
+		dcache_evict (d);
+	rwlock_release_write (&dcache_lock);
+}
+
+/* Drops every cached entry of directory DIR_SECTOR. */
+static void
+dcache_remove_dir (disk_sector_t dir_sector) {
+	struct list_elem *e, *next;
+
+	rwlock_acquire_write (&dcache_lock);
+	for (e = list_begin (&dcache_fifo); e != list_end (&dcache_fifo); e = next) {
+		struct dcache_entry *d = list_entry (e, struct dcache_entry, list_elem);
+		next = list_next (e);
+		if (d->dir_sector == dir_sector)
+			dcache_evict (d);
+	}
+	rwlock_release_write (&dcache_lock);
+}
+
+/* Initializes the directory module. */
+void
+dir_init (void) {
+	hash_init (&dcache, dcache_hash, dcache_less, NULL);
+	list_init (&dcache_fifo);
+	dcache_cnt = 0;
+	rwlock_init (&dcache_lock);
+}
+
+/* Returns the number of entry slots in DIR's table. */
+static size_t
+slot_cnt (const struct dir *dir) {
+	return inode_length (dir->inode) / sizeof (struct dir_entry);
+}
+
+/* Returns the slot NAME hashes to in a table of SLOTS slots. */
+static size_t
+home_slot (const char *name, size_t slots) {
+	return hash_string (name) % slots;
+}
+
+/* Returns true if E has never held an entry, which ends a probe. */
+static inline bool
+slot_never_used (const struct dir_entry *e) {
+	return !e->in_use && e->name[0] == '\0';
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
  * given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (disk_sector_t sector, size_t entry_cnt) {
+	/* SECTOR may have held another directory before. */
+	dcache_remove_dir (sector);
 	return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
 }
 
@@ -46,7 +216,11 @@ dir_open (struct inode *inode) {
  * Return true if successful, false on failure. */
 struct dir *
 dir_open_root (void) {
+#ifdef EFILESYS
+	return dir_open (inode_open (cluster_to_sector (ROOT_DIR_CLUSTER)));
+#else
 	return dir_open (inode_open (ROOT_DIR_SECTOR));
+#endif
 }
 
 /* Opens and returns a new directory for the same inode as DIR.
@@ -80,13 +254,21 @@ static bool
 lookup (const struct dir *dir, const char *name,
 		struct dir_entry *ep, off_t *ofsp) {
 	struct dir_entry e;
-	size_t ofs;
+	size_t slots, home, i;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
+	slots = slot_cnt (dir);
+	if (slots == 0)
+		return false;
+
+	home = home_slot (name, slots);
+	for (i = 0; i < slots; i++) {
+		off_t ofs = (home + i) % slots * sizeof e;
+		if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e
+				|| slot_never_used (&e))
+			break;
 		if (e.in_use && !strcmp (name, e.name)) {
 			if (ep != NULL)
 				*ep = e;
@@ -94,9 +276,93 @@ lookup (const struct dir *dir, const char *name,
 				*ofsp = ofs;
 			return true;
 		}
+	}
 	return false;
 }
 
+/* Searches DIR for a slot to store NAME in.
+ * Returns false if NAME is already in DIR.  Otherwise returns true
+ * and sets *OFSP to the byte offset of the first free slot on NAME's
+ * probe sequence (-1 if there is none) and *PROBEP to its distance
+ * from NAME's home slot. */
+static bool
+find_free_slot (const struct dir *dir, const char *name,
+		off_t *ofsp, size_t *probep) {
+	struct dir_entry e;
+	size_t slots = slot_cnt (dir);
+	size_t i;
+
+	*ofsp = -1;
+	*probep = 0;
+	if (slots == 0)
+		return true;
+
+	size_t home = home_slot (name, slots);
+	for (i = 0; i < slots; i++) {
+		off_t ofs = (home + i) % slots * sizeof e;
+		if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+			break;
+		if (e.in_use) {
+			if (!strcmp (name, e.name))
+				return false;
+			continue;
+		}
+		if (*ofsp == -1) {
+			*ofsp = ofs;
+			*probep = i;
+		}
+		if (slot_never_used (&e))
+			break;
+	}
+	return true;
+}
+
+/* Resizes DIR's table to NEW_SLOTS slots and re-inserts every live
+ * entry, which also drops all tombstones.
+ * Returns false, leaving DIR untouched, if the directory cannot grow
+ * or memory runs out. */
+static bool
+rehash (struct dir *dir, size_t new_slots) {
+	size_t old_slots = slot_cnt (dir);
+	off_t old_size = old_slots * sizeof (struct dir_entry);
+	off_t new_size = new_slots * sizeof (struct dir_entry);
+	struct dir_entry *old_table = NULL, *new_table = NULL;
+	struct dir_entry zero;
+	bool success = false;
+	size_t i;
+
+	ASSERT (new_slots > old_slots);
+
+	old_table = malloc (old_size > 0 ? old_size : 1);
+	new_table = calloc (new_slots, sizeof *new_table);
+	if (old_table == NULL || new_table == NULL)
+		goto done;
+	if (inode_read_at (dir->inode, old_table, old_size, 0) != old_size)
+		goto done;
+
+	/* Grow the file first; this fails if the inode cannot grow. */
+	memset (&zero, 0, sizeof zero);
+	if (inode_write_at (dir->inode, &zero, sizeof zero, new_size - sizeof zero)
+			!= sizeof zero)
+		goto done;
+
+	for (i = 0; i < old_slots; i++) {
+		size_t slot;
+		if (!old_table[i].in_use)
+			continue;
+		slot = home_slot (old_table[i].name, new_slots);
+		while (new_table[slot].in_use)
+			slot = (slot + 1) % new_slots;
+		new_table[slot] = old_table[i];
+	}
+	success = inode_write_at (dir->inode, new_table, new_size, 0) == new_size;
+
+done:
+	free (old_table);
+	free (new_table);
+	return success;
+}
+
 /* Searches DIR for a file with the given NAME
  * and returns true if one exists, false otherwise.
  * On success, sets *INODE to an inode for the file, otherwise to
@@ -105,14 +371,24 @@ bool
 dir_lookup (const struct dir *dir, const char *name,
 		struct inode **inode) {
 	struct dir_entry e;
+	disk_sector_t dir_sector, inode_sector;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	if (lookup (dir, name, &e, NULL))
+	/* The cache is consulted under the directory lock, as dir_remove()
+	 * drops entries under it: otherwise a hit could open an inode that
+	 * was just removed, or whatever file has since reused its sector. */
+	dir_sector = inode_get_inumber (dir->inode);
+	inode_lock_dir (dir->inode);
+	if (dcache_lookup (dir_sector, name, &inode_sector))
+		*inode = inode_open (inode_sector);
+	else if (lookup (dir, name, &e, NULL)) {
+		dcache_insert (dir_sector, name, e.inode_sector);
 		*inode = inode_open (e.inode_sector);
-	else
+	} else
 		*inode = NULL;
+	inode_unlock_dir (dir->inode);
 
 	return *inode != NULL;
 }
@@ -127,6 +403,7 @@ bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	struct dir_entry e;
 	off_t ofs;
+	size_t probe;
 	bool success = false;
 
 	ASSERT (dir != NULL);
@@ -136,29 +413,34 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	if (*name == '\0' || strlen (name) > NAME_MAX)
 		return false;
 
-	/* Check that NAME is not in use. */
-	if (lookup (dir, name, NULL, NULL))
-		goto done;
+	inode_lock_dir (dir->inode);
 
-	/* Set OFS to offset of free slot.
-	 * If there are no free slots, then it will be set to the
-	 * current end-of-file.
+	/* Find a free slot on NAME's probe sequence, checking that NAME
+	 * is not in use on the way. */
+	if (!find_free_slot (dir, name, &ofs, &probe))
+		goto done;
 
-	 * inode_read_at() will only return a short read at end of file.
-	 * Otherwise, we'd need to verify that we didn't get a short
-	 * read due to something intermittent such as low memory. */
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (!e.in_use)
-			break;
+	/* If the table is full or NAME would land too far from its home
+	 * slot, try to double the table.  Directories that cannot grow
+	 * keep using whatever slot was found. */
+	if (ofs == -1 || probe > DIR_MAX_PROBE) {
+		size_t slots = slot_cnt (dir);
+		if (rehash (dir, slots < DIR_MIN_SLOTS / 2 ? DIR_MIN_SLOTS : slots * 2))
+			find_free_slot (dir, name, &ofs, &probe);
+	}
+	if (ofs == -1)
+		goto done;
 
 	/* Write slot. */
 	e.in_use = true;
 	strlcpy (e.name, name, sizeof e.name);
 	e.inode_sector = inode_sector;
 	success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+	if (success)
+		dcache_insert (inode_get_inumber (dir->inode), name, inode_sector);
 
 done:
+	inode_unlock_dir (dir->inode);
 	return success;
 }
 
@@ -175,6 +457,8 @@ dir_remove (struct dir *dir, const char *name) {
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
+	inode_lock_dir (dir->inode);
+
 	/* Find directory entry. */
 	if (!lookup (dir, name, &e, &ofs))
 		goto done;
@@ -184,7 +468,8 @@ dir_remove (struct dir *dir, const char *name) {
 	if (inode == NULL)
 		goto done;
 
-	/* Erase directory entry. */
+	/* Erase directory entry, leaving its name behind as a tombstone. */
+	dcache_remove (inode_get_inumber (dir->inode), name);
 	e.in_use = false;
 	if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
 		goto done;
@@ -194,6 +479,7 @@ dir_remove (struct dir *dir, const char *name) {
 	success = true;
 
 done:
+	inode_unlock_dir (dir->inode);
 	inode_close (inode);
 	return success;
 }
@@ -204,13 +490,17 @@ done:
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1]) {
 	struct dir_entry e;
+	bool success = false;
 
+	inode_lock_dir (dir->inode);
 	while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
 		dir->pos += sizeof e;
 		if (e.in_use) {
 			strlcpy (name, e.name, NAME_MAX + 1);
-			return true;
+			success = true;
+			break;
 		}
 	}
-	return false;
+	inode_unlock_dir (dir->inode);
+	return success;
 }
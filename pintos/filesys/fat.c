@@ -1,4 +1,5 @@
 #include "filesys/fat.h"
+#include <bitmap.h>
 #include "devices/disk.h"
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
@@ -24,12 +25,16 @@ struct fat_fs {
 	disk_sector_t data_start;
 	cluster_t last_clst;
 	struct lock write_lock;
+	struct bitmap *used_map;     /* One bit per cluster, true if in use. */
+	size_t free_cnt;             /* Number of free clusters. */
 };
 
 static struct fat_fs *fat_fs;
 
 void fat_boot_create (void);
 void fat_fs_init (void);
+static void fat_build_used_map (void);
+static cluster_t fat_alloc_cluster (cluster_t hint);
 
 void
 fat_init (void) {
@@ -53,6 +58,7 @@ fat_init (void) {
 
 void
 fat_open (void) {
+	free (fat_fs->fat);
 	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT load failed");
@@ -78,6 +84,8 @@ fat_open (void) {
 			free (bounce);
 		}
 	}
+
+	fat_build_used_map ();
 }
 
 void
@@ -120,9 +128,11 @@ fat_create (void) {
 	fat_fs_init ();
 
 	// Create FAT table
+	free (fat_fs->fat);
 	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT creation failed");
+	fat_build_used_map ();
 
 	// Set up ROOT_DIR_CLST
 	fat_put (ROOT_DIR_CLUSTER, EOChain);
@@ -152,7 +162,60 @@ fat_boot_create (void) {
 
 void
 fat_fs_init (void) {
-	/* TODO: Your code goes here. */
+	/* Data region starts right after the FAT itself.  Entry 0 of the
+	 * FAT is reserved, so cluster N lives at data sector N - 1. */
+	fat_fs->data_start = fat_fs->bs.fat_start + fat_fs->bs.fat_sectors;
+	fat_fs->fat_length = (fat_fs->bs.total_sectors - fat_fs->data_start)
+	                     / SECTORS_PER_CLUSTER + 1;
+
+	/* Never index past what the on-disk FAT can describe. */
+	size_t fat_entries =
+	    fat_fs->bs.fat_sectors * DISK_SECTOR_SIZE / sizeof (cluster_t);
+	if (fat_fs->fat_length > fat_entries)
+		fat_fs->fat_length = fat_entries;
+
+	fat_fs->last_clst = ROOT_DIR_CLUSTER;
+	lock_init_named (&fat_fs->write_lock, "fat_write");
+}
+
+/* Rebuilds the in-memory free-cluster index from the FAT.
+ * This is the only full scan of the table; afterwards the index is
+ * kept up to date by fat_put(). */
+static void
+fat_build_used_map (void) {
+	if (fat_fs->used_map != NULL)
+		bitmap_destroy (fat_fs->used_map);
+	fat_fs->used_map = bitmap_create (fat_fs->fat_length);
+	if (fat_fs->used_map == NULL)
+		PANIC ("FAT free-cluster map creation failed");
+
+	/* Cluster 0 means "no cluster" and is never handed out. */
+	bitmap_mark (fat_fs->used_map, 0);
+	fat_fs->free_cnt = fat_fs->fat_length - 1;
+	for (cluster_t clst = 1; clst < fat_fs->fat_length; clst++)
+		if (fat_fs->fat[clst] != 0) {
+			bitmap_mark (fat_fs->used_map, clst);
+			fat_fs->free_cnt--;
+		}
+	fat_fs->last_clst = ROOT_DIR_CLUSTER;
+}
+
+/* Finds a free cluster, preferring HINT and the clusters after it so
+ * that chains grown one cluster at a time stay contiguous on disk.
+ * Returns 0 if the disk is full.  The cluster is not yet marked used. */
+static cluster_t
+fat_alloc_cluster (cluster_t hint) {
+	size_t clst;
+
+	if (fat_fs->free_cnt == 0)
+		return 0;
+	if (hint == 0 || hint >= fat_fs->fat_length)
+		hint = 1;
+
+	clst = bitmap_scan (fat_fs->used_map, hint, 1, false);
+	if (clst == BITMAP_ERROR)
+		clst = bitmap_scan (fat_fs->used_map, 1, 1, false);
+	return clst == BITMAP_ERROR ? 0 : clst;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -164,30 +227,78 @@ fat_fs_init (void) {
  * Returns 0 if fails to allocate a new cluster. */
 cluster_t
 fat_create_chain (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	cluster_t new_clst;
+
+	ASSERT (clst < fat_fs->fat_length);
+
+	lock_acquire (&fat_fs->write_lock);
+	/* Extending a chain tries the cluster right after its tail first;
+	 * a new chain starts from the last allocation point. */
+	new_clst = fat_alloc_cluster (clst != 0 ? clst + 1 : fat_fs->last_clst);
+	if (new_clst != 0) {
+		fat_put (new_clst, EOChain);
+		if (clst != 0)
+			fat_put (clst, new_clst);
+		fat_fs->last_clst = new_clst;
+	}
+	lock_release (&fat_fs->write_lock);
+	return new_clst;
 }
 
 /* Remove the chain of clusters starting from CLST.
  * If PCLST is 0, assume CLST as the start of the chain. */
 void
 fat_remove_chain (cluster_t clst, cluster_t pclst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst != 0 && clst < fat_fs->fat_length);
+
+	lock_acquire (&fat_fs->write_lock);
+	if (pclst != 0)
+		fat_put (pclst, EOChain);
+
+	while (clst != EOChain) {
+		cluster_t next = fat_get (clst);
+		ASSERT (next != 0);
+		fat_put (clst, 0);
+		clst = next;
+	}
+	lock_release (&fat_fs->write_lock);
 }
 
 /* Update a value in the FAT table. */
 void
 fat_put (cluster_t clst, cluster_t val) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst != 0 && clst < fat_fs->fat_length);
+
+	bool was_used = fat_fs->fat[clst] != 0;
+	fat_fs->fat[clst] = val;
+
+	/* Keep the free-cluster index in sync. */
+	if (fat_fs->used_map != NULL && was_used != (val != 0)) {
+		bitmap_set (fat_fs->used_map, clst, val != 0);
+		if (val != 0)
+			fat_fs->free_cnt--;
+		else
+			fat_fs->free_cnt++;
+	}
 }
 
 /* Fetch a value in the FAT table. */
 cluster_t
 fat_get (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst != 0 && clst < fat_fs->fat_length);
+	return fat_fs->fat[clst];
 }
 
 /* Covert a cluster # to a sector number. */
 disk_sector_t
 cluster_to_sector (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst != 0 && clst < fat_fs->fat_length);
+	return fat_fs->data_start + (clst - 1) * SECTORS_PER_CLUSTER;
+}
+
+/* Covert a sector number inside the data region to its cluster #. */
+cluster_t
+sector_to_cluster (disk_sector_t sector) {
+	ASSERT (sector >= fat_fs->data_start);
+	return (sector - fat_fs->data_start) / SECTORS_PER_CLUSTER + 1;
 }
@@ -1,19 +1,32 @@
 #include "filesys/inode.h"
+#include <hash.h>
 #include <list.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/fat.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#ifdef VM
+#include "filesys/page_cache.h"
+#endif
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Maximum number of closed inodes kept in memory for reuse. */
+#define INODE_CACHE_MAX 64
+
 /* On-disk inode.
  * Must be exactly DISK_SECTOR_SIZE bytes long. */
 struct inode_disk {
-	disk_sector_t start;                /* First data sector. */
+	disk_sector_t start;                /* First data sector.  With EFILESYS,
+	                                       first cluster of the data chain
+	                                       (0 if the file is empty). */
 	off_t length;                       /* File size in bytes. */
 	unsigned magic;                     /* Magic number. */
 	uint32_t unused[125];               /* Not used. */
@@ -26,37 +39,296 @@ bytes_to_sectors (off_t size) {
 	return DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
 }
 
+#ifdef EFILESYS
+/* Bytes in one FAT cluster. */
+#define CLUSTER_SIZE (DISK_SECTOR_SIZE * SECTORS_PER_CLUSTER)
+
+/* Returns the number of clusters to allocate for an inode SIZE
+ * bytes long. */
+static inline size_t
+bytes_to_clusters (off_t size) {
+	return DIV_ROUND_UP (size, CLUSTER_SIZE);
+}
+#endif
+
 /* In-memory inode. */
 struct inode {
-	struct list_elem elem;              /* Element in inode list. */
+	struct hash_elem elem;              /* Element in open_inodes. */
+	struct list_elem lru_elem;          /* Element in closed_inodes. */
 	disk_sector_t sector;               /* Sector number of disk location. */
-	int open_cnt;                       /* Number of openers. */
+	int open_cnt;                       /* Number of openers, 0 if cached. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
 	struct inode_disk data;             /* Inode content. */
+
+	/* Reader/writer lock on the inode's data: inode_read_at() runs
+	 * concurrently with other readers, inode_write_at() runs alone.
+	 * LOCK protects the fields below and, with EFILESYS, the chain
+	 * cache.  The data lock is never held while touching user
+	 * memory; see inode_user_io(). */
+	struct lock lock;
+	struct condition rw_cond;           /* Signaled when the state changes. */
+	int readers;                        /* Number of active readers. */
+	int writers_waiting;                /* Number of waiting writers. */
+	bool writing;                       /* True while a writer is active. */
+
+	struct lock dir_lock;               /* Serializes directory operations. */
+#ifdef EFILESYS
+	/* Cache of the data chain: clusters[i] is the disk cluster that
+	 * holds the file's i-th cluster.  Filled lazily from the FAT, so a
+	 * given link of the chain is walked at most once per open inode. */
+	cluster_t *clusters;
+	size_t cluster_cnt;                 /* Valid entries in CLUSTERS. */
+	size_t cluster_cap;                 /* Allocated entries in CLUSTERS. */
+#endif
 };
 
+#ifdef EFILESYS
+/* Appends CLST to INODE's chain cache.
+ * Returns false if memory allocation fails. */
+static bool
+chain_cache_push (struct inode *inode, cluster_t clst) {
+	if (inode->cluster_cnt == inode->cluster_cap) {
+		size_t new_cap = inode->cluster_cap ? inode->cluster_cap * 2 : 16;
+		cluster_t *new_clusters =
+			realloc (inode->clusters, new_cap * sizeof *new_clusters);
+		if (new_clusters == NULL)
+			return false;
+		inode->clusters = new_clusters;
+		inode->cluster_cap = new_cap;
+	}
+	inode->clusters[inode->cluster_cnt++] = clst;
+	return true;
+}
+
+/* Returns the disk cluster holding INODE's IDX-th data cluster, or 0
+ * if the chain is shorter than that.  Only the links past the cached
+ * prefix are read from the FAT.
+ * Must be called with INODE's lock held. */
+static cluster_t
+chain_cache_lookup (struct inode *inode, size_t idx) {
+	while (idx >= inode->cluster_cnt) {
+		cluster_t next = inode->cluster_cnt == 0
+			? inode->data.start
+			: fat_get (inode->clusters[inode->cluster_cnt - 1]);
+		if (next == 0 || next == EOChain)
+			return 0;
+		if (!chain_cache_push (inode, next)) {
+			/* Out of memory: walk the chain without caching. */
+			cluster_t clst = next;
+			for (size_t i = inode->cluster_cnt; i < idx; i++) {
+				clst = fat_get (clst);
+				if (clst == EOChain)
+					return 0;
+			}
+			return clst;
+		}
+	}
+	return inode->clusters[idx];
+}
+
+/* Like chain_cache_lookup(), but takes INODE's lock itself. */
+static cluster_t
+inode_cluster_at (struct inode *inode, size_t idx) {
+	cluster_t clst;
+
+	lock_acquire (&inode->lock);
+	clst = chain_cache_lookup (inode, idx);
+	lock_release (&inode->lock);
+	return clst;
+}
+
+/* Writes zeros over every sector of cluster CLST. */
+static void
+zero_cluster (cluster_t clst) {
+	static char zeros[DISK_SECTOR_SIZE];
+	disk_sector_t sector = cluster_to_sector (clst);
+
+	for (size_t i = 0; i < SECTORS_PER_CLUSTER; i++)
+		disk_write (filesys_disk, sector + i, zeros);
+}
+
+/* Appends CNT zeroed clusters to the chain ending at TAIL (0 to start
+ * a new chain) and stores the first new cluster in *HEADP.
+ * On failure nothing is allocated and false is returned. */
+static bool
+allocate_chain (cluster_t tail, size_t cnt, cluster_t *headp) {
+	cluster_t head = 0;
+
+	for (size_t i = 0; i < cnt; i++) {
+		tail = fat_create_chain (tail);
+		if (tail == 0) {
+			if (head != 0)
+				fat_remove_chain (head, 0);
+			return false;
+		}
+		if (head == 0)
+			head = tail;
+		zero_cluster (tail);
+	}
+	*headp = head;
+	return true;
+}
+
+/* Extends INODE so that it is at least LENGTH bytes long, allocating
+ * zeroed clusters as needed, and writes the updated inode back.
+ * Returns false if the disk is full. */
+static bool
+inode_grow (struct inode *inode, off_t length) {
+	size_t have = bytes_to_clusters (inode->data.length);
+	size_t need = bytes_to_clusters (length);
+
+	if (need > have) {
+		cluster_t tail = have == 0 ? 0 : inode_cluster_at (inode, have - 1);
+		cluster_t head;
+
+		if (!allocate_chain (tail, need - have, &head))
+			return false;
+		if (inode->data.start == 0)
+			inode->data.start = head;
+	}
+	inode->data.length = length;
+	disk_write (filesys_disk, inode->sector, &inode->data);
+	return true;
+}
+#endif
+
+/* Acquires INODE's data lock for reading.  New readers wait while a
+ * writer is waiting, so that a stream of readers cannot starve
+ * writers. */
+static void
+inode_read_lock (struct inode *inode) {
+	lock_acquire (&inode->lock);
+	while (inode->writing || inode->writers_waiting > 0)
+		cond_wait (&inode->rw_cond, &inode->lock);
+	inode->readers++;
+	lock_release (&inode->lock);
+}
+
+/* Releases INODE's data lock held for reading. */
+static void
+inode_read_unlock (struct inode *inode) {
+	lock_acquire (&inode->lock);
+	ASSERT (inode->readers > 0);
+	if (--inode->readers == 0)
+		cond_broadcast (&inode->rw_cond, &inode->lock);
+	lock_release (&inode->lock);
+}
+
+/* Acquires INODE's data lock for writing. */
+static void
+inode_write_lock (struct inode *inode) {
+	lock_acquire (&inode->lock);
+	inode->writers_waiting++;
+	while (inode->writing || inode->readers > 0)
+		cond_wait (&inode->rw_cond, &inode->lock);
+	inode->writers_waiting--;
+	inode->writing = true;
+	lock_release (&inode->lock);
+}
+
+/* Releases INODE's data lock held for writing. */
+static void
+inode_write_unlock (struct inode *inode) {
+	lock_acquire (&inode->lock);
+	ASSERT (inode->writing);
+	inode->writing = false;
+	cond_broadcast (&inode->rw_cond, &inode->lock);
+	lock_release (&inode->lock);
+}
+
 /* Returns the disk sector that contains byte offset POS within
  * INODE.
  * Returns -1 if INODE does not contain data for a byte at offset
  * POS. */
 static disk_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) {
+byte_to_sector (struct inode *inode, off_t pos) {
 	ASSERT (inode != NULL);
-	if (pos < inode->data.length)
-		return inode->data.start + pos / DISK_SECTOR_SIZE;
-	else
+	if (pos >= inode->data.length)
 		return -1;
+#ifdef EFILESYS
+	cluster_t clst = inode_cluster_at (inode, pos / CLUSTER_SIZE);
+	if (clst == 0)
+		return -1;
+	return cluster_to_sector (clst) + pos % CLUSTER_SIZE / DISK_SECTOR_SIZE;
+#else
+	return inode->data.start + pos / DISK_SECTOR_SIZE;
+#endif
+}
+
+/* In-memory inodes, keyed by sector, so that opening a single inode
+ * twice returns the same `struct inode'.  Besides the open inodes this
+ * holds up to INODE_CACHE_MAX closed ones (open_cnt == 0), kept on
+ * closed_inodes in least-recently-closed order, so that re-opening a
+ * hot file needs no disk_read().
+ * Both are protected by inodes_lock. */
+static struct hash open_inodes;
+static struct list closed_inodes;
+static size_t closed_cnt;
+static struct lock inodes_lock;
+
+static uint64_t
+inode_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct inode *inode = hash_entry (e, struct inode, elem);
+	return hash_int (inode->sector);
 }
 
-/* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
-static struct list open_inodes;
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct inode, elem)->sector
+		< hash_entry (b, struct inode, elem)->sector;
+}
+
+/* Returns the in-memory inode for SECTOR, or a null pointer.
+ * Must be called with inodes_lock held. */
+static struct inode *
+inode_find (disk_sector_t sector) {
+	struct inode key;
+	struct hash_elem *e;
+
+	key.sector = sector;
+	e = hash_find (&open_inodes, &key.elem);
+	return e != NULL ? hash_entry (e, struct inode, elem) : NULL;
+}
+
+/* Frees INODE's memory. */
+static void
+inode_free (struct inode *inode) {
+#ifdef EFILESYS
+	free (inode->clusters);
+#endif
+	free (inode);
+}
+
+/* Drops closed INODE from the cache and frees it.
+ * Must be called with inodes_lock held. */
+static void
+inode_evict (struct inode *inode) {
+	ASSERT (inode->open_cnt == 0);
+	hash_delete (&open_inodes, &inode->elem);
+	list_remove (&inode->lru_elem);
+	closed_cnt--;
+	inode_free (inode);
+}
+
+/* Takes another reference to INODE, pulling it out of the closed
+ * cache if needed.  Must be called with inodes_lock held. */
+static void
+inode_ref (struct inode *inode) {
+	if (inode->open_cnt++ == 0) {
+		list_remove (&inode->lru_elem);
+		closed_cnt--;
+	}
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
-	list_init (&open_inodes);
+	hash_init (&open_inodes, inode_hash, inode_less, NULL);
+	list_init (&closed_inodes);
+	closed_cnt = 0;
+	lock_init_named (&inodes_lock, "inodes");
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -75,7 +347,27 @@ inode_create (disk_sector_t sector, off_t length) {
 	 * one sector in size, and you should fix that. */
 	ASSERT (sizeof *disk_inode == DISK_SECTOR_SIZE);
 
+	/* SECTOR is being reused, so a cached copy of whatever inode used
+	 * to live there is stale. */
+	lock_acquire (&inodes_lock);
+	struct inode *stale = inode_find (sector);
+	if (stale != NULL && stale->open_cnt == 0)
+		inode_evict (stale);
+	lock_release (&inodes_lock);
+
 	disk_inode = calloc (1, sizeof *disk_inode);
+#ifdef EFILESYS
+	if (disk_inode != NULL) {
+		disk_inode->length = length;
+		disk_inode->magic = INODE_MAGIC;
+		disk_inode->start = 0;
+		if (allocate_chain (0, bytes_to_clusters (length), &disk_inode->start)) {
+			disk_write (filesys_disk, sector, disk_inode);
+			success = true;
+		}
+		free (disk_inode);
+	}
+#else
 	if (disk_inode != NULL) {
 		size_t sectors = bytes_to_sectors (length);
 		disk_inode->length = length;
@@ -93,6 +385,7 @@ inode_create (disk_sector_t sector, off_t length) {
 		} 
 		free (disk_inode);
 	}
+#endif
 	return success;
 }
 
@@ -101,18 +394,17 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
-	struct inode *inode;
-
-	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
+	struct inode *inode, *other;
+
+	/* Check whether this inode is already open or cached. */
+	lock_acquire (&inodes_lock);
+	inode = inode_find (sector);
+	if (inode != NULL) {
+		inode_ref (inode);
+		lock_release (&inodes_lock);
+		return inode;
 	}
+	lock_release (&inodes_lock);
 
 	/* Allocate memory. */
 	inode = malloc (sizeof *inode);
@@ -120,20 +412,43 @@ inode_open (disk_sector_t sector) {
 		return NULL;
 
 	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
+	lock_init_named (&inode->lock, "inode");
+	cond_init (&inode->rw_cond);
+	inode->readers = inode->writers_waiting = 0;
+	inode->writing = false;
+	lock_init_named (&inode->dir_lock, "inode_dir");
+#ifdef EFILESYS
+	inode->clusters = NULL;
+	inode->cluster_cnt = inode->cluster_cap = 0;
+#endif
 	disk_read (filesys_disk, inode->sector, &inode->data);
+
+	/* Someone else may have opened SECTOR while we were reading. */
+	lock_acquire (&inodes_lock);
+	other = inode_find (sector);
+	if (other != NULL) {
+		inode_ref (other);
+		lock_release (&inodes_lock);
+		inode_free (inode);
+		return other;
+	}
+	hash_insert (&open_inodes, &inode->elem);
+	lock_release (&inodes_lock);
 	return inode;
 }
 
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
-	if (inode != NULL)
+	if (inode != NULL) {
+		lock_acquire (&inodes_lock);
 		inode->open_cnt++;
+		lock_release (&inodes_lock);
+	}
 	return inode;
 }
 
@@ -144,8 +459,9 @@ inode_get_inumber (const struct inode *inode) {
 }
 
 /* Closes INODE and writes it to disk.
- * If this was the last reference to INODE, frees its memory.
- * If INODE was also a removed inode, frees its blocks. */
+ * If this was the last reference to INODE, moves it to the closed
+ * inode cache, evicting the oldest cached inode if the cache is full.
+ * If INODE was also a removed inode, frees its memory and blocks. */
 void
 inode_close (struct inode *inode) {
 	/* Ignore null pointer. */
@@ -153,19 +469,36 @@ inode_close (struct inode *inode) {
 		return;
 
 	/* Release resources if this was the last opener. */
+	lock_acquire (&inodes_lock);
 	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
-		list_remove (&inode->elem);
-
-		/* Deallocate blocks if removed. */
-		if (inode->removed) {
-			free_map_release (inode->sector, 1);
-			free_map_release (inode->data.start,
-					bytes_to_sectors (inode->data.length)); 
+		/* Keep the inode around for a later inode_open(), unless it
+		 * was removed. */
+		if (!inode->removed) {
+			list_push_back (&closed_inodes, &inode->lru_elem);
+			if (++closed_cnt > INODE_CACHE_MAX)
+				inode_evict (list_entry (list_front (&closed_inodes),
+							struct inode, lru_elem));
+			lock_release (&inodes_lock);
+			return;
 		}
 
-		free (inode); 
-	}
+		/* Remove from inode table and release lock. */
+		hash_delete (&open_inodes, &inode->elem);
+		lock_release (&inodes_lock);
+
+		/* Deallocate blocks. */
+#ifdef EFILESYS
+		fat_remove_chain (sector_to_cluster (inode->sector), 0);
+		if (inode->data.start != 0)
+			fat_remove_chain (inode->data.start, 0);
+#else
+		free_map_release (inode->sector, 1);
+		free_map_release (inode->data.start,
+				bytes_to_sectors (inode->data.length));
+#endif
+		inode_free (inode);
+	} else
+		lock_release (&inodes_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -176,6 +509,45 @@ inode_remove (struct inode *inode) {
 	inode->removed = true;
 }
 
+/* Moves SIZE bytes between user memory at UBUF and INODE at
+ * OFFSET, reading from the inode or, if WRITE, writing to it.  The
+ * data goes through a kernel page, a page at a time, and UBUF is
+ * only touched while the inode is unlocked: touching it may fault,
+ * and the fault may need this same inode (UBUF mmap'd from it, or
+ * eviction writing back one of its dirty pages), which would
+ * deadlock on the data lock.  A large transfer is therefore not
+ * atomic with respect to other readers and writers.
+ * Returns the number of bytes moved. */
+static off_t
+inode_user_io (struct inode *inode, uint8_t *ubuf, off_t size, off_t offset,
+		bool write) {
+	uint8_t sector[DISK_SECTOR_SIZE];
+	uint8_t *kpage = palloc_get_page (0);
+	uint8_t *kbuf = kpage != NULL ? kpage : sector;
+	off_t kbuf_size = kpage != NULL ? PGSIZE : DISK_SECTOR_SIZE;
+	off_t done = 0;
+
+	/* Out of pages, go a sector at a time rather than fail: a short
+	 * count here would look like end of file to read(). */
+	while (done < size) {
+		off_t chunk = size - done < kbuf_size ? size - done : kbuf_size;
+		off_t cnt;
+
+		if (write) {
+			memcpy (kbuf, ubuf + done, chunk);
+			cnt = inode_write_at (inode, kbuf, chunk, offset + done);
+		} else {
+			cnt = inode_read_at (inode, kbuf, chunk, offset + done);
+			memcpy (ubuf + done, kbuf, cnt);
+		}
+		done += cnt;
+		if (cnt < chunk)
+			break;
+	}
+	palloc_free_page (kpage);
+	return done;
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
  * Returns the number of bytes actually read, which may be less
  * than SIZE if an error occurs or end of file is reached. */
@@ -185,6 +557,14 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	off_t bytes_read = 0;
 	uint8_t *bounce = NULL;
 
+	if (!is_kernel_vaddr (buffer))
+		return inode_user_io (inode, buffer, size, offset, false);
+#ifdef VM
+	/* Unmapped pages still queued for writeback are newer than what
+	 * is on disk. */
+	page_cache_sync (inode);
+#endif
+	inode_read_lock (inode);
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
 		disk_sector_t sector_idx = byte_to_sector (inode, offset);
@@ -220,6 +600,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
+	inode_read_unlock (inode);
 	free (bounce);
 
 	return bytes_read;
@@ -228,8 +609,8 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
  * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
+ * With EFILESYS a write past end of file extends the inode first;
+ * otherwise growth is not implemented. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		off_t offset) {
@@ -237,8 +618,22 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 	off_t bytes_written = 0;
 	uint8_t *bounce = NULL;
 
-	if (inode->deny_write_cnt)
+	if (!is_kernel_vaddr (buffer))
+		return inode_user_io (inode, (uint8_t *) buffer, size, offset, true);
+#ifdef VM
+	/* Don't let queued writeback land on top of this write. */
+	page_cache_sync (inode);
+#endif
+	inode_write_lock (inode);
+	if (inode->deny_write_cnt) {
+		inode_write_unlock (inode);
 		return 0;
+	}
+
+#ifdef EFILESYS
+	if (size > 0 && offset + size > inode_length (inode))
+		inode_grow (inode, offset + size);
+#endif
 
 	while (size > 0) {
 		/* Sector to write, starting byte offset within sector. */
@@ -282,18 +677,21 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
+	inode_write_unlock (inode);
 	free (bounce);
 
 	return bytes_written;
 }
 
-/* Disables writes to INODE.
-   May be called at most once per inode opener. */
-	void
-inode_deny_write (struct inode *inode) 
-{
+/* Disables writes to INODE, waiting for any write in progress to
+ * finish.
+ * May be called at most once per inode opener. */
+void
+inode_deny_write (struct inode *inode) {
+	inode_write_lock (inode);
 	inode->deny_write_cnt++;
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+	inode_write_unlock (inode);
 }
 
 /* Re-enables writes to INODE.
@@ -303,7 +701,9 @@ void
 inode_allow_write (struct inode *inode) {
 	ASSERT (inode->deny_write_cnt > 0);
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+	inode_write_lock (inode);
 	inode->deny_write_cnt--;
+	inode_write_unlock (inode);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -311,3 +711,16 @@ off_t
 inode_length (const struct inode *inode) {
 	return inode->data.length;
 }
+
+/* Acquires INODE's directory lock.  directory.c holds it across each
+ * operation that searches or modifies the directory INODE. */
+void
+inode_lock_dir (struct inode *inode) {
+	lock_acquire (&inode->dir_lock);
+}
+
+/* Releases INODE's directory lock. */
+void
+inode_unlock_dir (struct inode *inode) {
+	lock_release (&inode->dir_lock);
+}
@@ -1,9 +1,20 @@
 /* page_cache.c: Implementation of Page Cache (Buffer Cache). */
 
 #include "vm/vm.h"
+#include <list.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/inode.h"
+#include "filesys/page_cache.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
 static bool page_cache_readahead (struct page *page, void *kva);
 static bool page_cache_writeback (struct page *page);
 static void page_cache_destroy (struct page *page);
+static void page_cache_kworkerd (void *aux);
 
 /* DO NOT MODIFY this struct */
 static const struct page_operations page_cache_op = {
@@ -15,36 +26,315 @@ static const struct page_operations page_cache_op = {
 
 tid_t page_cache_workerd;
 
+/* A dirty file page waiting to be written back.
+ *
+ * Unmapping a dirty file-backed page hands its frame to the page
+ * cache instead of writing it out on the spot, so munmap() and exit
+ * do no disk I/O.  The kworker writes queued pages back in batches
+ * sorted by inode and offset, and merges runs of adjacent pages into
+ * a single write.
+ *
+ * Pages that are still mapped are not written back periodically.
+ * They reach the disk when evicted, unmapped or at exit.  A periodic
+ * scan would need each frame's owning page table, which struct frame
+ * does not record, and a way to keep that process from exiting under
+ * the kworker. */
+struct wb_page {
+	struct list_elem elem;              /* Element in wb_list. */
+	struct inode *inode;                /* File to write to (a reference). */
+	off_t ofs;                          /* Offset of the page in INODE. */
+	size_t bytes;                       /* Bytes of KVA to write. */
+	void *kva;                          /* Page contents, owned. */
+};
+
+/* Delay between being kicked and starting a flush, so that pages
+ * unmapped together are sorted and written together. */
+#define WB_DELAY (TIMER_FREQ / 20)
+
+/* Pages the kworker writes before yielding the CPU. */
+#define WB_BATCH 32
+
+/* Longest run of adjacent pages merged into one write. */
+#define WB_MAX_RUN 8
+
+/* Queued pages beyond which page_cache_queue() waits for the kworker
+ * to catch up.  This many wb_pages are preallocated. */
+#define WB_DIRTY_LIMIT 256
+
+static struct list wb_list;             /* Queued pages, oldest first. */
+static size_t wb_cnt;                   /* Number of pages in wb_list. */
+static struct wb_page wb_nodes[WB_DIRTY_LIMIT];
+static struct list wb_free;             /* Unused members of wb_nodes. */
+static size_t wb_retired;               /* Pages written back so far. */
+static bool wb_urgent;                  /* Flush now, skipping WB_DELAY. */
+static struct lock wb_lock;             /* Protects the members above. */
+static struct condition wb_drained;     /* Signaled when pages retire. */
+static struct lock wb_io_lock;          /* Held while writing pages back. */
+static struct semaphore wb_kick;        /* Wakes up the kworker. */
+static uint8_t *wb_bounce;              /* WB_MAX_RUN pages for merging. */
+
 /* The initializer of file vm */
 void
 pagecache_init (void) {
-	/* TODO: Create a worker daemon for page cache with page_cache_kworkerd */
+	list_init (&wb_list);
+	wb_cnt = 0;
+	list_init (&wb_free);
+	for (size_t i = 0; i < WB_DIRTY_LIMIT; i++)
+		list_push_back (&wb_free, &wb_nodes[i].elem);
+	wb_retired = 0;
+	wb_urgent = false;
+	lock_init_named (&wb_lock, "page_cache_wb");
+	cond_init (&wb_drained);
+	lock_init_named (&wb_io_lock, "page_cache_wb_io");
+	sema_init (&wb_kick, 0);
+
+	/* Without a bounce buffer pages are simply written one by one. */
+	wb_bounce = palloc_get_multiple (0, WB_MAX_RUN);
+
+	page_cache_workerd = thread_create ("page_cache", PRI_DEFAULT,
+			page_cache_kworkerd, NULL);
+	if (page_cache_workerd == TID_ERROR)
+		PANIC ("can't create page cache worker");
+}
+
+/* Queues the first BYTES bytes of the page at KVA for writing back to
+ * INODE at offset OFS.  KVA must be a page from the user pool; the
+ * page cache takes it over and frees it once written.  INODE is
+ * reopened, so the caller may close it right away.
+ *
+ * Never does I/O and cannot fail.  If WB_DIRTY_LIMIT pages are
+ * already queued, waits for the kworker to drain some. */
+void
+page_cache_queue (struct inode *inode, off_t ofs, size_t bytes, void *kva) {
+	struct wb_page *wb;
+
+	lock_acquire (&wb_lock);
+	while (list_empty (&wb_free))
+		cond_wait (&wb_drained, &wb_lock);
+	wb = list_entry (list_pop_front (&wb_free), struct wb_page, elem);
+	wb->inode = inode_reopen (inode);
+	wb->ofs = ofs;
+	wb->bytes = bytes;
+	wb->kva = kva;
+	list_push_back (&wb_list, &wb->elem);
+	if (wb_cnt++ == 0)
+		sema_up (&wb_kick);
+	lock_release (&wb_lock);
 }
 
-/* Initialize the page cache */
+/* Returns true if queued page A sorts before B: by inode sector, then
+ * by offset, which is the order in which their sectors lie on disk. */
+static bool
+wb_less (const struct wb_page *a, const struct wb_page *b) {
+	disk_sector_t a_sector = inode_get_inumber (a->inode);
+	disk_sector_t b_sector = inode_get_inumber (b->inode);
+
+	return a_sector != b_sector ? a_sector < b_sector : a->ofs < b->ofs;
+}
+
+/* Returns true if B holds the page that directly follows A. */
+static bool
+wb_adjacent (const struct wb_page *a, const struct wb_page *b) {
+	return a->inode == b->inode && a->bytes == PGSIZE
+		&& a->ofs + PGSIZE == b->ofs;
+}
+
+/* Writes the CNT adjacent pages in RUN with a single inode_write_at()
+ * when they fit in the bounce buffer. */
+static void
+write_run (struct wb_page **run, size_t cnt) {
+	struct wb_page *last = run[cnt - 1];
+	size_t i;
+
+	if (cnt == 1) {
+		inode_write_at (run[0]->inode, run[0]->kva, run[0]->bytes,
+				run[0]->ofs);
+		return;
+	}
+	for (i = 0; i < cnt; i++)
+		memcpy (wb_bounce + i * PGSIZE, run[i]->kva, PGSIZE);
+	inode_write_at (run[0]->inode, wb_bounce,
+			(cnt - 1) * PGSIZE + last->bytes, run[0]->ofs);
+}
+
+/* Writes back up to WB_BATCH queued pages, oldest first, restricted
+ * to pages of INODE unless it is a null pointer.  Returns the number
+ * of pages written.  Must be called with wb_io_lock held. */
+static size_t
+flush_pages (struct inode *inode) {
+	struct wb_page *batch[WB_BATCH];
+	struct list_elem *e;
+	size_t cnt = 0;
+	size_t i, j;
+
+	ASSERT (lock_held_by_current_thread (&wb_io_lock));
+
+	/* Pick pages.  They stay on wb_list until written, so that
+	 * page_cache_sync() sees them and waits on wb_io_lock for this
+	 * batch to finish. */
+	lock_acquire (&wb_lock);
+	for (e = list_begin (&wb_list); e != list_end (&wb_list) && cnt < WB_BATCH;
+			e = list_next (e)) {
+		struct wb_page *wb = list_entry (e, struct wb_page, elem);
+		if (inode == NULL || wb->inode == inode)
+			batch[cnt++] = wb;
+	}
+	lock_release (&wb_lock);
+
+	/* Sort into disk order.  Batches are small, so insertion sort. */
+	for (i = 1; i < cnt; i++) {
+		struct wb_page *wb = batch[i];
+		for (j = i; j > 0 && wb_less (wb, batch[j - 1]); j--)
+			batch[j] = batch[j - 1];
+		batch[j] = wb;
+	}
+
+	/* Write runs of adjacent pages. */
+	for (i = 0; i < cnt; i = j) {
+		size_t max_run = wb_bounce != NULL ? WB_MAX_RUN : 1;
+		for (j = i + 1; j < cnt && j - i < max_run
+				&& wb_adjacent (batch[j - 1], batch[j]); j++)
+			continue;
+		write_run (batch + i, j - i);
+	}
+
+	/* Retire the batch. */
+	lock_acquire (&wb_lock);
+	for (i = 0; i < cnt; i++)
+		list_remove (&batch[i]->elem);
+	wb_cnt -= cnt;
+	wb_retired += cnt;
+	lock_release (&wb_lock);
+
+	for (i = 0; i < cnt; i++) {
+		inode_close (batch[i]->inode);
+		palloc_free_page (batch[i]->kva);
+	}
+
+	lock_acquire (&wb_lock);
+	for (i = 0; i < cnt; i++)
+		list_push_back (&wb_free, &batch[i]->elem);
+	cond_broadcast (&wb_drained, &wb_lock);
+	lock_release (&wb_lock);
+	return cnt;
+}
+
+/* Writes back every queued page of INODE, so that a following read
+ * or write of INODE is ordered after them. */
+void
+page_cache_sync (struct inode *inode) {
+	struct list_elem *e;
+	bool queued = false;
+
+	/* The kworker's own writes come through here too. */
+	if (wb_cnt == 0 || lock_held_by_current_thread (&wb_io_lock))
+		return;
+
+	lock_acquire (&wb_lock);
+	for (e = list_begin (&wb_list); e != list_end (&wb_list); e = list_next (e))
+		if (list_entry (e, struct wb_page, elem)->inode == inode) {
+			queued = true;
+			break;
+		}
+	lock_release (&wb_lock);
+
+	if (queued) {
+		lock_acquire (&wb_io_lock);
+		while (flush_pages (inode) > 0)
+			continue;
+		lock_release (&wb_io_lock);
+	}
+}
+
+/* Writes back every queued page, for shutdown.
+ * Returns true if any page was freed. */
+bool
+page_cache_flush (void) {
+	size_t total = 0, cnt;
+
+	if (wb_cnt == 0 || lock_held_by_current_thread (&wb_io_lock))
+		return false;
+
+	lock_acquire (&wb_io_lock);
+	while ((cnt = flush_pages (NULL)) > 0)
+		total += cnt;
+	lock_release (&wb_io_lock);
+	return total > 0;
+}
+
+/* Has the kworker write back every page queued so far and waits for
+ * it, for memory pressure.  The caller is usually handling a page
+ * fault, possibly one taken while copying a user buffer for a read
+ * or write of some inode, so it must not write pages back itself.
+ * Returns true if any page was freed. */
 bool
-page_cache_initializer (struct page *page, enum vm_type type, void *kva) {
+page_cache_reclaim (void) {
+	size_t target;
+
+	if (wb_cnt == 0 || thread_tid () == page_cache_workerd)
+		return false;
+
+	lock_acquire (&wb_lock);
+	if (wb_cnt == 0) {
+		lock_release (&wb_lock);
+		return false;
+	}
+	target = wb_retired + wb_cnt;
+	wb_urgent = true;
+	sema_up (&wb_kick);
+	while (wb_retired < target)
+		cond_wait (&wb_drained, &wb_lock);
+	lock_release (&wb_lock);
+	return true;
+}
+
+/* Initialize the page cache.
+ * No page is ever of type VM_PAGE_CACHE: mapped file pages stay
+ * VM_FILE, and only their frames are handed to the writeback queue
+ * above once unmapped.  The operations below exist to fill in
+ * page_cache_op and do nothing. */
+bool
+page_cache_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva UNUSED) {
 	/* Set up the handler */
 	page->operations = &page_cache_op;
-
+	return true;
 }
 
-/* Utilze the Swap in mechanism to implement readhead */
+/* Utilze the Swap in mechanism to implement readhead.  Unused. */
 static bool
-page_cache_readahead (struct page *page, void *kva) {
+page_cache_readahead (struct page *page UNUSED, void *kva UNUSED) {
+	return false;
 }
 
-/* Utilze the Swap out mechanism to implement writeback */
+/* Utilze the Swap out mechanism to implement writeback.  Unused. */
 static bool
-page_cache_writeback (struct page *page) {
+page_cache_writeback (struct page *page UNUSED) {
+	return false;
 }
 
-/* Destory the page_cache. */
+/* Destory the page_cache.  Unused. */
 static void
-page_cache_destroy (struct page *page) {
+page_cache_destroy (struct page *page UNUSED) {
 }
 
-/* Worker thread for page cache */
+/* Worker thread for page cache.
+ * Sleeps until pages are queued, waits WB_DELAY ticks for more to
+ * gather unless page_cache_reclaim() is waiting, then writes the
+ * queue back one batch at a time, yielding between batches so that
+ * it does not hog the CPU. */
 static void
-page_cache_kworkerd (void *aux) {
+page_cache_kworkerd (void *aux UNUSED) {
+	for (;;) {
+		sema_down (&wb_kick);
+		if (!wb_urgent)
+			timer_sleep (WB_DELAY);
+		wb_urgent = false;
+		while (wb_cnt > 0) {
+			lock_acquire (&wb_io_lock);
+			flush_pages (NULL);
+			lock_release (&wb_io_lock);
+			thread_yield ();
+		}
+	}
 }
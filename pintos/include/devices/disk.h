@@ -1,7 +1,11 @@
 #ifndef DEVICES_DISK_H
 #define DEVICES_DISK_H
 
+#include <diskstat.h>
 #include <inttypes.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* Size of a disk sector in bytes. */
@@ -15,6 +19,25 @@ typedef uint32_t disk_sector_t;
  * printf ("sector=%"PRDSNu"\n", sector); */
 #define PRDSNu PRIu32
 
+struct disk_request;
+
+/* Called when a submitted request completes. */
+typedef void disk_done_func (struct disk_request *, void *aux);
+
+/* An asynchronous disk request, for disk_submit(). */
+struct disk_request {
+	struct disk *disk;          /* Disk to access. */
+	disk_sector_t sec_no;       /* First sector. */
+	size_t cnt;                 /* Number of sectors. */
+	void *buffer;               /* CNT * DISK_SECTOR_SIZE bytes. */
+	bool write;                 /* Write if true, read if false. */
+	disk_done_func *done;       /* Completion callback. */
+	void *aux;                  /* Passed to DONE. */
+	struct list_elem elem;      /* Owned by disk.c. */
+	uint64_t submit_time;       /* TSC at disk_submit(). */
+	uint64_t start_time;        /* TSC at disk_started(). */
+};
+
 void disk_init (void);
 void disk_print_stats (void);
 
@@ -22,6 +45,15 @@ struct disk *disk_get (int chan_no, int dev_no);
 disk_sector_t disk_size (struct disk *);
 void disk_read (struct disk *, disk_sector_t, void *);
 void disk_write (struct disk *, disk_sector_t, const void *);
+void disk_read_multiple (struct disk *, disk_sector_t, size_t cnt, void *);
+void disk_write_multiple (struct disk *, disk_sector_t, size_t cnt,
+		const void *);
+void disk_submit (struct disk_request *);
+void disk_stats (struct disk *, struct diskstat *);
+
+/* For drivers. */
+void disk_started (struct disk_request *);
+void disk_complete (struct disk_request *);
 
 void 	register_disk_inspect_intr ();
 #endif /* devices/disk.h */
@@ -0,0 +1,43 @@
+#ifndef DEVICES_PCI_H
+#define DEVICES_PCI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Location of a PCI function in configuration space. */
+struct pci_dev {
+	uint8_t bus;                /* Bus number. */
+	uint8_t dev;                /* Device number, 0...31. */
+	uint8_t func;               /* Function number, 0...7. */
+};
+
+/* Offsets of common configuration registers. */
+#define PCI_VENDOR_ID 0x00      /* Vendor ID (16 bits). */
+#define PCI_DEVICE_ID 0x02      /* Device ID (16 bits). */
+#define PCI_COMMAND 0x04        /* Command (16 bits). */
+#define PCI_PROG_IF 0x09        /* Programming interface (8 bits). */
+#define PCI_SUBCLASS 0x0a       /* Subclass (8 bits). */
+#define PCI_CLASS 0x0b          /* Base class (8 bits). */
+#define PCI_HEADER_TYPE 0x0e    /* Header type (8 bits). */
+#define PCI_BAR0 0x10           /* First base address register. */
+#define PCI_INTERRUPT_LINE 0x3c /* Legacy IRQ line (8 bits). */
+
+/* Command register bits. */
+#define PCI_CMD_IO 0x0001       /* Respond to I/O space accesses. */
+#define PCI_CMD_MEMORY 0x0002   /* Respond to memory space accesses. */
+#define PCI_CMD_MASTER 0x0004   /* Enable bus mastering. */
+
+uint32_t pci_read32 (const struct pci_dev *, uint8_t reg);
+uint16_t pci_read16 (const struct pci_dev *, uint8_t reg);
+uint8_t pci_read8 (const struct pci_dev *, uint8_t reg);
+void pci_write32 (const struct pci_dev *, uint8_t reg, uint32_t);
+void pci_write16 (const struct pci_dev *, uint8_t reg, uint16_t);
+
+bool pci_find_class (uint8_t class, uint8_t subclass, int index,
+		struct pci_dev *);
+bool pci_find_device (uint16_t vendor, uint16_t device, int index,
+		struct pci_dev *);
+uint16_t pci_io_bar (const struct pci_dev *, int bar);
+void pci_enable (const struct pci_dev *, uint16_t cmd_bits);
+
+#endif /* devices/pci.h */
@@ -1,23 +1,53 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* A kernel timer.  FUNC is called, from the timer interrupt, at
+   the first tick at or after DEADLINE.  Embed one in the structure
+   it belongs to, initialize it with timer_event_init(), and arm it
+   with timer_add(). */
+struct timer_event;
+typedef void timer_event_func (struct timer_event *);
+struct timer_event {
+	struct list_elem elem;      /* Element in a timer wheel slot. */
+	int64_t deadline;           /* Tick at which to fire. */
+	timer_event_func *func;     /* Called when the timer fires. */
+	void *aux;                  /* For FUNC's use. */
+	bool pending;               /* Armed and not yet fired? */
+};
+
 void timer_init (void);
 void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_ns (void);
+int64_t timer_tsc_to_ns (uint64_t tsc);
 
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+void timer_event_init (struct timer_event *, timer_event_func *, void *aux);
+void timer_add (struct timer_event *, int64_t deadline);
+bool timer_cancel (struct timer_event *);
+
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
+/* Called with the interrupted frame at each profiling sample. */
+struct intr_frame;
+typedef void timer_sample_func (struct intr_frame *);
+int timer_start_sampling (timer_sample_func *, int hz);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
@@ -0,0 +1,21 @@
+#ifndef DEVICES_VIRTIO_BLK_H
+#define DEVICES_VIRTIO_BLK_H
+
+#include "devices/disk.h"
+
+/* Legacy virtio-blk PCI devices.  disk.c puts them behind the
+   ordinary disk interface: a device in PCI slot VBLK_PCI_SLOT + N
+   stands in for disk N (that is, hd<N/2>:<N%2>) when there is no
+   ATA disk in that position.  Disks 4 and 5 (hd2:0 and hd2:1)
+   can only be virtio.  "pintos --virtio" attaches disks this
+   way. */
+#define VBLK_PCI_SLOT 0x10
+
+struct vblk;
+
+void vblk_init (void);
+struct vblk *vblk_get (int disk_no);
+disk_sector_t vblk_capacity (const struct vblk *);
+void vblk_submit (struct vblk *, struct disk_request *);
+
+#endif /* devices/virtio-blk.h */
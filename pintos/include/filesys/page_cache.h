@@ -1,12 +1,19 @@
 #ifndef FILESYS_PAGE_CACHE_H
 #define FILESYS_PAGE_CACHE_H
-#include "vm/vm.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
 
 struct page;
+struct inode;
 enum vm_type;
 
 struct page_cache {};
 
-void page_cache_init (void);
+void pagecache_init (void);
 bool page_cache_initializer (struct page *page, enum vm_type type, void *kva);
+void page_cache_queue (struct inode *, off_t ofs, size_t bytes, void *kva);
+void page_cache_sync (struct inode *);
+bool page_cache_flush (void);
+bool page_cache_reclaim (void);
 #endif
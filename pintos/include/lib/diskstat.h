@@ -0,0 +1,34 @@
+#ifndef __LIB_DISKSTAT_H
+#define __LIB_DISKSTAT_H
+
+#include <stdint.h>
+
+/* Latency histograms have log2 buckets: bucket I counts requests
+   that took at least 2**I and less than 2**(I+1) TSC cycles
+   (bucket 0 also takes 0 cycles).  The last bucket takes anything
+   longer. */
+#define DISKSTAT_BUCKETS 48
+
+/* I/O statistics for one disk, as returned by the diskstat()
+   system call.  A request is counted as one disk_submit() call,
+   which may cover many sectors. */
+struct diskstat {
+	int64_t read_cnt;                   /* Sectors read. */
+	int64_t write_cnt;                  /* Sectors written. */
+	uint64_t requests;                  /* Requests submitted. */
+	uint64_t sequential;                /* Requests that began where the
+	                                       previous one ended. */
+
+	uint32_t depth;                     /* Requests queued or in service. */
+	uint32_t max_depth;                 /* Largest DEPTH seen. */
+	uint64_t depth_sum;                 /* Sum of DEPTH at each submission,
+	                                       counting the new request. */
+
+	uint64_t completed;                 /* Requests completed. */
+	uint64_t wait_cycles;               /* Total time queued. */
+	uint64_t service_cycles;            /* Total time in service. */
+	uint64_t wait_hist[DISKSTAT_BUCKETS];       /* Time queued. */
+	uint64_t service_hist[DISKSTAT_BUCKETS];    /* Time in service. */
+};
+
+#endif /* lib/diskstat.h */
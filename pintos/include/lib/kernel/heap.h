@@ -0,0 +1,62 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Pairing heap.
+ *
+ * A priority queue that finds its smallest element in O(1) time,
+ * inserts in O(1), and removes the smallest or any other element
+ * in O(log n) amortized time.  An element whose key moves toward
+ * the front can be repositioned in O(1) with heap_raise().
+ * Elements that compare equal come out in no particular order;
+ * callers that need FIFO order break ties themselves.
+ *
+ * Like lists and hash tables, the heap does not use dynamic
+ * allocation.  Each structure that can be in a heap embeds a
+ * struct heap_elem member, and heap_entry converts a struct
+ * heap_elem back to the structure that contains it.  See
+ * lib/kernel/list.h for a detailed explanation of the
+ * technique. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem {
+	struct heap_elem *child;    /* Leftmost child, or NULL. */
+	struct heap_elem *next;     /* Right sibling, or NULL. */
+	struct heap_elem *prev;     /* Left sibling, or parent if leftmost. */
+};
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+ * the structure that HEAP_ELEM is embedded inside.  Supply the
+ * name of the outer structure STRUCT and the member name MEMBER
+ * of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)                   \
+	((STRUCT *) ((uint8_t *) &(HEAP_ELEM)->child            \
+		- offsetof (STRUCT, MEMBER.child)))
+
+/* Compares the value of two heap elements A and B, given
+ * auxiliary data AUX.  Returns true if A is less than B, or false
+ * if A is greater than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+		const struct heap_elem *b,
+		void *aux);
+
+/* Pairing heap. */
+struct heap {
+	struct heap_elem *root;     /* Smallest element, or NULL if empty. */
+	heap_less_func *less;       /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `less'. */
+};
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+void heap_push (struct heap *, struct heap_elem *);
+struct heap_elem *heap_pop (struct heap *);
+void heap_remove (struct heap *, struct heap_elem *);
+void heap_raise (struct heap *, struct heap_elem *);
+
+bool heap_empty (const struct heap *);
+struct heap_elem *heap_top (const struct heap *);
+
+#endif /* lib/kernel/heap.h */
@@ -0,0 +1,44 @@
+#ifndef __LIB_LOCKSTAT_H
+#define __LIB_LOCKSTAT_H
+
+#include <stdint.h>
+
+/* Most lock classes the kernel keeps statistics for.  Locks
+   initialized once the table is full are not counted. */
+#define LOCKSTAT_MAX 64
+
+/* Longest lock name kept, including the null terminator. */
+#define LOCKSTAT_NAME_LEN 24
+
+/* Call sites kept per lock class that waited the longest. */
+#define LOCKSTAT_WAITERS 4
+
+/* A place that waited for a lock. */
+struct lockstat_waiter {
+	uint64_t rip;                       /* Caller of lock_acquire(). */
+	uint64_t count;                     /* Contended acquisitions. */
+	uint64_t wait_cycles;               /* Total time waited. */
+};
+
+/* Contention statistics for one lock class, as returned by the
+   lockstat() system call.  A class is every lock initialized with
+   the same name, or, for unnamed locks, at the same call site.
+   Times are in TSC cycles. */
+struct lockstat {
+	char name[LOCKSTAT_NAME_LEN];       /* Name, or "" if unnamed. */
+	uint64_t init_rip;                  /* Caller of lock_init(). */
+	uint64_t locks;                     /* Locks initialized. */
+
+	uint64_t acquisitions;              /* Times acquired. */
+	uint64_t contended;                 /* Times that had to wait. */
+	uint64_t wait_cycles;               /* Total time waited. */
+	uint64_t max_wait_cycles;           /* Longest single wait. */
+	uint64_t hold_cycles;               /* Total time held. */
+	uint64_t max_hold_cycles;           /* Longest single hold. */
+
+	/* The call sites that waited longest, approximately: a new
+	   site replaces the one with the least total wait. */
+	struct lockstat_waiter waiters[LOCKSTAT_WAITERS];
+};
+
+#endif /* lib/lockstat.h */
@@ -36,6 +36,11 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Instrumentation. */
+	SYS_DISKSTAT,               /* Reads a disk's I/O statistics. */
+	SYS_CLOCK_GETTIME,          /* Reads a clock. */
+	SYS_LOCKSTAT,               /* Reads lock contention statistics. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,16 @@
+#ifndef __LIB_TIME_H
+#define __LIB_TIME_H
+
+#include <stdint.h>
+
+/* Clocks for the clock_gettime() system call. */
+typedef int clockid_t;
+#define CLOCK_MONOTONIC 1           /* Time since boot, from the TSC. */
+
+/* A point in time, as seconds plus nanoseconds. */
+struct timespec {
+	int64_t tv_sec;                 /* Seconds. */
+	long tv_nsec;                   /* Nanoseconds, 0...999,999,999. */
+};
+
+#endif /* lib/time.h */
@@ -3,7 +3,10 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <diskstat.h>
+#include <lockstat.h>
 #include <stddef.h>
+#include <time.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -50,6 +53,11 @@ bool isdir (int fd);
 int inumber (int fd);
 int symlink (const char* target, const char* linkpath);
 
+/* Instrumentation. */
+bool diskstat (int chan_no, int dev_no, struct diskstat *);
+int clock_gettime (clockid_t, struct timespec *);
+int lockstat (struct lockstat *, int max);
+
 static inline void* get_phys_addr (void *user_addr) {
 	void* pa;
 	asm volatile ("movq %0, %%rax" ::"r"(user_addr));
@@ -0,0 +1,14 @@
+#ifndef THREADS_PROFILE_H
+#define THREADS_PROFILE_H
+
+#include <stdbool.h>
+
+/* Sampling profiler.  Enabled by kernel command-line option
+   "-profile[=HZ]"; the samples are printed at power off for
+   utils/backtrace --profile to symbolize. */
+extern int profile_hz;
+
+void profile_init(void);
+void profile_print_stats(void);
+
+#endif /* threads/profile.h */
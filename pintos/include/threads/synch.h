@@ -1,13 +1,17 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
+#include <lockstat.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
 
 /* A counting semaphore. */
 struct semaphore {
 	unsigned value;             /* Current value. */
-	struct list waiters;        /* List of waiting threads. */
+	struct heap waiters;        /* Waiting threads, highest priority on top. */
 };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -21,17 +25,66 @@ struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
 	struct list_elem holder_elem; /* thread의 acquired_locks의 노드 */
+#ifdef LOCK_STATS
+	struct lockstat *stats;     /* Statistics for this lock's class. */
+	uint64_t acquired_tsc;      /* TSC when last acquired. */
+#endif
 };
 
 void lock_init (struct lock *);
+void lock_init_named (struct lock *, const char *name);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+int lock_stats (struct lockstat *, int max);
+void lock_print_stats (void);
+
+/* Spinlock.  Held only briefly, with interrupts off, and never
+   across anything that sleeps.  Usable from interrupt handlers. */
+struct spinlock {
+	volatile int locked;        /* 1 if held, 0 if free. */
+	struct thread *holder;      /* Thread holding lock (for debugging). */
+	enum intr_level old_level;  /* Interrupt level before spin_lock(). */
+};
+
+void spin_init (struct spinlock *);
+void spin_lock (struct spinlock *);
+bool spin_trylock (struct spinlock *);
+void spin_unlock (struct spinlock *);
+bool spin_held_by_current_thread (const struct spinlock *);
+
+/* Reader-writer lock.  Any number of readers, or one writer.
+   Writers are preferred: once a writer is waiting, new readers
+   wait behind it. */
+struct rwlock {
+	struct lock gate;           /* Held by the writer; readers pass through. */
+	unsigned readers;           /* Readers inside. */
+	struct thread *drainer;     /* Writer waiting for READERS to reach 0. */
+};
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
+/* Adaptive mutex: a lock that spins for a while, as long as its
+   holder is running, before it sleeps. */
+struct mutex {
+	struct lock lock;           /* Underlying lock. */
+};
+
+void mutex_init (struct mutex *);
+void mutex_acquire (struct mutex *);
+bool mutex_try_acquire (struct mutex *);
+void mutex_release (struct mutex *);
+bool mutex_held_by_current_thread (const struct mutex *);
 
 /* Condition variable. */
 struct condition {
-	struct list waiters;        /* List of waiting threads. */
+	struct heap waiters;        /* Waiting threads, highest priority on top. */
 };
 
 void cond_init (struct condition *);
@@ -39,6 +92,8 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+void synch_priority_changed (struct thread *, int old_priority);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
@@ -3,8 +3,10 @@
 
 #include <debug.h>
 #include <list.h>
+#include <rbtree.h>
 #include <stdint.h>
 
+#include "devices/timer.h"
 #include "threads/fixed-point.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
@@ -85,12 +87,9 @@ typedef int tid_t;
  * the `magic' member of the running thread's `struct thread' is
  * set to THREAD_MAGIC.  Stack overflow will normally ge this
  * value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
- * the run queue (thread.c), or it can be an element in a
- * semaphore wait list (synch.c).  It can be used these two ways
- * only because they are mutually exclusive: only a thread in the
- * ready state is on the run queue, whereas only a thread in the
- * blocked state is on a semaphore wait list. */
+/* The `elem' member is an element in the run queue (thread.c).
+ * A thread waiting on a semaphore or condition variable is in
+ * that object's waiter heap through `wait_elem' (synch.c). */
 struct thread {
   /* Owned by thread.c. */
   tid_t tid;                 /* Thread identifier. */
@@ -100,8 +99,13 @@ struct thread {
 
   /* Shared between thread.c and synch.c. */
   struct list_elem elem;       /* List element. */
-  int64_t wake_tick;           /* 쓰레드를 깨울 시간 */
-  struct list_elem sleep_elem; /* sleep_list에서의 연결리스트 노드 */
+  struct heap_elem wait_elem;     /* semaphore/condition 대기 heap에서의 노드 */
+  struct heap *wait_queue;        /* wait_elem이 들어 있는 heap, 없으면 NULL */
+  int64_t wait_seq;               /* 같은 우선순위끼리는 먼저 온 순서대로 깨우기 위한 순번 */
+  bool cond_signaled;             /* cond_wait 중에 signal을 받았는지 */
+  struct timer_event sleep_timer; /* timer_sleep()에서 깨울 때 쓰는 타이머 */
+  int64_t wake_ns;                /* sub-tick sleep에서 깨울 시각 (timer_ns 기준) */
+  struct list_elem sleep_elem;    /* hr_sleep_list에서의 연결리스트 노드 */
   struct list_elem all_elem;   /* all_list에서의 연결리스트 노드 */
 
   int original_priority;         /* 원래 우선순위(기부 이전) */
@@ -112,6 +116,15 @@ struct thread {
   /* mlfqs 전용*/
   int nice;           /* CPU를 양보하는 척도 (-20~20) */
   fixed_t recent_cpu; /* 최근 CPU 사용량 (fixed-point)*/
+  int64_t mlfqs_epoch;         /* recent_cpu가 반영한 마지막 초 */
+  struct list_elem mlfqs_elem; /* mlfqs_fresh/mlfqs_stale에서의 노드 */
+
+  /* cfs 전용 */
+  int64_t vruntime;        /* 가중치를 반영한 누적 실행 시간 (ns) */
+  int64_t sum_exec;        /* 실제 누적 실행 시간 (ns) */
+  int64_t exec_start;      /* 마지막으로 실행 시간을 정산한 시각 (timer_ns) */
+  int64_t slice_start;     /* 이번 time slice를 시작할 때의 sum_exec */
+  struct rb_node cfs_node; /* cfs_tree에서의 노드 */
 
   /* process wait, exit 용 */
   struct list child_list;     // child_info 의 리스트
@@ -154,10 +167,16 @@ struct child_info {
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the fair-share scheduler, which runs the ready
+   thread with the least weighted virtual runtime.
+   Controlled by kernel command-line option "-cfs". */
+extern bool thread_cfs;
+
 void thread_init(void);
 void thread_start(void);
 
 void thread_tick(void);
+void thread_account_idle(int64_t n);
 void thread_print_stats(void);
 
 typedef void thread_func(void *aux);
@@ -179,22 +198,24 @@ void thread_set_priority(int);
 int thread_get_nice(void);
 void thread_set_nice(int);
 int thread_get_recent_cpu(void);
-void thread_update_all_recent_cpu(void);
 int thread_get_load_avg(void);
 void thread_update_load_avg(void);
 void do_iret(struct intr_frame *tf);
 
-struct list *get_ready_list(void);
-struct list *get_sleep_list(void);
 
-void thread_update_all_priority(void);
+void thread_mlfqs_new_second(void);
+void thread_mlfqs_refresh(void);
 void mlfqs_update_priority(struct thread *t);
-bool thread_priority_less(const struct list_elem *, const struct list_elem *, void *);
 bool is_not_idle(struct thread *);
-int max_priority_mlfqs_queue(void);
+int max_ready_priority(void);
+void thread_requeue(struct thread *t, int priority);
 
 struct thread *thread_get_by_tid(tid_t tid);  // userprog 추가
 
+/* Performs some operation on thread t, given auxiliary data AUX. */
+typedef void thread_action_func(struct thread *t, void *aux);
+void thread_foreach(thread_action_func *, void *);
+
 struct file *init_std();
 struct file *get_std_in();   // userprog 추가
 struct file *get_std_out();  // userprog 추가
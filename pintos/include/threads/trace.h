@@ -0,0 +1,25 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+
+struct lock;
+struct thread;
+
+/* Scheduler event tracing.  Enabled by kernel command-line option
+   "-trace"; the events are printed at power off for
+   utils/sched-trace to convert. */
+extern bool trace_enabled;
+
+void trace_init(void);
+void trace_print_stats(void);
+
+void trace_create(const struct thread *t);
+void trace_switch(const struct thread *prev, const struct thread *next);
+void trace_wakeup(const struct thread *t);
+void trace_preempt(void);
+void trace_donate(const struct thread *recipient, int priority);
+void trace_lock_wait(const struct lock *lock);
+void trace_lock_acquired(const struct lock *lock);
+
+#endif /* threads/trace.h */
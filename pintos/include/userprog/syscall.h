@@ -5,8 +5,6 @@
 typedef int pid_t;
 #define PID_ERROR ((pid_t)-1)
 
-extern struct lock filesys_lock;
-
 void syscall_init(void);
 void system_exit(int status);
 void system_close(int fd);
@@ -5,6 +5,7 @@ struct page;
 enum vm_type;
 extern int* swap_table;
 extern struct lock swap_lock;
+extern const char *swap_disks_option; /* -swap 커널 옵션 */
 
 struct anon_page {
   int swap_index; /* swap table에서의 bitmap index*/
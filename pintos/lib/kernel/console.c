@@ -1,6 +1,7 @@
 #include <console.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/serial.h"
 #include "devices/vga.h"
 #include "threads/init.h"
@@ -59,13 +60,24 @@ static int console_lock_depth;
 /* Number of characters written to console. */
 static int64_t write_cnt;
 
+/* False if output should go to the serial port only, as set by
+   the -novga kernel option.  Each character sent to the VGA
+   display also costs several port writes to move the cursor. */
+static bool use_vga = true;
+
 /* Enable console locking. */
 void
 console_init (void) {
-	lock_init (&console_lock);
+	lock_init_named (&console_lock, "console");
 	use_console_lock = true;
 }
 
+/* Stops sending console output to the VGA display. */
+void
+console_disable_vga (void) {
+	use_vga = false;
+}
+
 /* Notifies the console that a kernel panic is underway,
    which warns it to avoid trying to take the console lock from
    now on. */
@@ -138,12 +150,29 @@ puts (const char *s) {
 	return 0;
 }
 
-/* Writes the N characters in BUFFER to the console. */
+/* Writes the N characters in BUFFER to the console.  The serial
+   port gets them a chunk at a time, so this does not wait for
+   them to be transmitted. */
 void
 putbuf (const char *buffer, size_t n) {
 	acquire_console ();
-	while (n-- > 0)
-		putchar_have_lock (*buffer++);
+	write_cnt += n;
+	while (n > 0) {
+		/* BUFFER may be in user memory, where touching it can page
+		   fault, so copy it here rather than with interrupts off
+		   inside serial_putbuf(). */
+		char chunk[128];
+		size_t size = n < sizeof chunk ? n : sizeof chunk;
+		size_t i;
+
+		memcpy (chunk, buffer, size);
+		serial_putbuf (chunk, size);
+		if (use_vga)
+			for (i = 0; i < size; i++)
+				vga_putc (chunk[i]);
+		buffer += size;
+		n -= size;
+	}
 	release_console ();
 }
 
@@ -173,5 +202,6 @@ putchar_have_lock (uint8_t c) {
 	ASSERT (console_locked_by_current_thread ());
 	write_cnt++;
 	serial_putc (c);
-	vga_putc (c);
+	if (use_vga)
+		vga_putc (c);
 }
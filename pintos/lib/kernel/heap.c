@@ -0,0 +1,172 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* Pairing heap, after Fredman, Sedgewick, Sleator and Tarjan,
+   "The pairing heap: a new form of self-adjusting heap" (1986).
+   The heap is a tree in which every node is no greater than its
+   children.  Each node keeps its children in a doubly linked
+   list, whose leftmost node points back to the parent. */
+
+/* Links two trees with roots A and B into one and returns its
+   root.  A and B must have no siblings. */
+static struct heap_elem *
+meld (struct heap *heap, struct heap_elem *a, struct heap_elem *b) {
+	if (heap->less (b, a, heap->aux)) {
+		struct heap_elem *t = a;
+		a = b;
+		b = t;
+	}
+
+	/* B becomes A's leftmost child. */
+	b->prev = a;
+	b->next = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	a->child = b;
+	return a;
+}
+
+/* Melds together the list of sibling trees starting at FIRST and
+   returns the root of the result, or NULL if FIRST is NULL.  The
+   first pass melds the trees in pairs from left to right; the
+   second melds the pairs from right to left.  This is what gives
+   the pairing heap its amortized bound. */
+static struct heap_elem *
+merge_pairs (struct heap *heap, struct heap_elem *first) {
+	struct heap_elem *pairs = NULL;     /* Stack, linked by `next'. */
+	struct heap_elem *root;
+
+	while (first != NULL) {
+		struct heap_elem *a = first;
+		struct heap_elem *b = a->next;
+		struct heap_elem *m;
+
+		a->prev = a->next = NULL;
+		if (b == NULL)
+			m = a;
+		else {
+			first = b->next;
+			b->prev = b->next = NULL;
+			m = meld (heap, a, b);
+		}
+		m->next = pairs;
+		pairs = m;
+		if (b == NULL)
+			break;
+	}
+
+	if (pairs == NULL)
+		return NULL;
+	root = pairs;
+	pairs = pairs->next;
+	root->next = NULL;
+	while (pairs != NULL) {
+		struct heap_elem *next = pairs->next;
+		pairs->next = NULL;
+		root = meld (heap, root, pairs);
+		pairs = next;
+	}
+	return root;
+}
+
+/* Unlinks ELEM, which must not be the root, from its parent and
+   siblings, leaving the subtree below ELEM intact. */
+static void
+cut (struct heap_elem *elem) {
+	if (elem->prev->child == elem)
+		elem->prev->child = elem->next;
+	else
+		elem->prev->next = elem->next;
+	if (elem->next != NULL)
+		elem->next->prev = elem->prev;
+	elem->prev = elem->next = NULL;
+}
+
+/* Initializes HEAP as an empty heap ordered by LESS, given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux) {
+	ASSERT (heap != NULL);
+	ASSERT (less != NULL);
+
+	heap->root = NULL;
+	heap->less = less;
+	heap->aux = aux;
+}
+
+/* Inserts ELEM into HEAP. */
+void
+heap_push (struct heap *heap, struct heap_elem *elem) {
+	ASSERT (heap != NULL);
+	ASSERT (elem != NULL);
+
+	elem->child = elem->next = elem->prev = NULL;
+	heap->root = heap->root != NULL ? meld (heap, heap->root, elem) : elem;
+}
+
+/* Removes the smallest element from HEAP, which must not be
+   empty, and returns it. */
+struct heap_elem *
+heap_pop (struct heap *heap) {
+	struct heap_elem *top;
+
+	ASSERT (!heap_empty (heap));
+
+	top = heap->root;
+	heap->root = merge_pairs (heap, top->child);
+	top->child = NULL;
+	return top;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+heap_remove (struct heap *heap, struct heap_elem *elem) {
+	struct heap_elem *sub;
+
+	ASSERT (heap != NULL);
+	ASSERT (elem != NULL);
+
+	if (elem == heap->root) {
+		heap_pop (heap);
+		return;
+	}
+	cut (elem);
+	sub = merge_pairs (heap, elem->child);
+	elem->child = NULL;
+	if (sub != NULL)
+		heap->root = meld (heap, heap->root, sub);
+}
+
+/* Restores HEAP's order after ELEM, which must be in HEAP, has
+   become smaller.  If ELEM may have become larger, use
+   heap_remove() and heap_push() instead. */
+void
+heap_raise (struct heap *heap, struct heap_elem *elem) {
+	ASSERT (heap != NULL);
+	ASSERT (elem != NULL);
+
+	if (elem == heap->root)
+		return;
+
+	/* ELEM is still no greater than its children, so its whole
+	   subtree moves up with it. */
+	cut (elem);
+	heap->root = meld (heap, heap->root, elem);
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (const struct heap *heap) {
+	ASSERT (heap != NULL);
+
+	return heap->root == NULL;
+}
+
+/* Returns the smallest element in HEAP, or NULL if HEAP is
+   empty. */
+struct heap_elem *
+heap_top (const struct heap *heap) {
+	ASSERT (heap != NULL);
+
+	return heap->root;
+}
@@ -0,0 +1,286 @@
+#include "rbtree.h"
+#include "../debug.h"
+
+/* Red-black tree, after the insertion and deletion algorithms in
+   [CLRS] chapter 13.  Leaves are null pointers, which count as
+   black. */
+
+static void rotate_left (struct rb_tree *, struct rb_node *);
+static void rotate_right (struct rb_tree *, struct rb_node *);
+static void replace_child (struct rb_tree *, struct rb_node *parent,
+		struct rb_node *old, struct rb_node *new);
+static void remove_fixup (struct rb_tree *, struct rb_node *parent,
+		struct rb_node *node);
+
+/* Returns true if NODE is red, false if it is black or a leaf. */
+static inline bool
+is_red (const struct rb_node *node) {
+	return node != NULL && node->red;
+}
+
+/* Initializes TREE as an empty tree ordered by LESS, given
+   auxiliary data AUX. */
+void
+rb_init (struct rb_tree *tree, rb_less_func *less, void *aux) {
+	ASSERT (tree != NULL);
+	ASSERT (less != NULL);
+
+	tree->root = tree->first = NULL;
+	tree->less = less;
+	tree->aux = aux;
+}
+
+/* Inserts NODE into TREE, after any nodes that compare equal to
+   it. */
+void
+rb_insert (struct rb_tree *tree, struct rb_node *node) {
+	struct rb_node *parent = NULL;
+	struct rb_node **link = &tree->root;
+	bool leftmost = true;
+
+	ASSERT (tree != NULL);
+	ASSERT (node != NULL);
+
+	/* Ordinary binary search tree insertion. */
+	while (*link != NULL) {
+		parent = *link;
+		if (tree->less (node, parent, tree->aux))
+			link = &parent->left;
+		else {
+			link = &parent->right;
+			leftmost = false;
+		}
+	}
+	node->parent = parent;
+	node->left = node->right = NULL;
+	node->red = true;
+	*link = node;
+	if (leftmost)
+		tree->first = node;
+
+	/* Restore the red-black properties: no red node has a red
+	   child. */
+	while (is_red (node->parent)) {
+		struct rb_node *p = node->parent;
+		struct rb_node *g = p->parent;
+
+		if (p == g->left) {
+			struct rb_node *uncle = g->right;
+			if (is_red (uncle)) {
+				p->red = uncle->red = false;
+				g->red = true;
+				node = g;
+				continue;
+			}
+			if (node == p->right) {
+				rotate_left (tree, p);
+				node = p;
+				p = node->parent;
+			}
+			p->red = false;
+			g->red = true;
+			rotate_right (tree, g);
+		} else {
+			struct rb_node *uncle = g->left;
+			if (is_red (uncle)) {
+				p->red = uncle->red = false;
+				g->red = true;
+				node = g;
+				continue;
+			}
+			if (node == p->left) {
+				rotate_right (tree, p);
+				node = p;
+				p = node->parent;
+			}
+			p->red = false;
+			g->red = true;
+			rotate_left (tree, g);
+		}
+	}
+	tree->root->red = false;
+}
+
+/* Removes NODE, which must be in TREE, from TREE. */
+void
+rb_remove (struct rb_tree *tree, struct rb_node *node) {
+	struct rb_node *child, *parent;
+	bool red;
+
+	ASSERT (tree != NULL);
+	ASSERT (node != NULL);
+
+	if (tree->first == node)
+		tree->first = rb_next (node);
+
+	if (node->left != NULL && node->right != NULL) {
+		/* Two children: unlink NODE's successor, which has no left
+		   child, and put it where NODE was. */
+		struct rb_node *next = node->right;
+		while (next->left != NULL)
+			next = next->left;
+
+		child = next->right;
+		parent = next->parent;
+		red = next->red;
+		if (child != NULL)
+			child->parent = parent;
+		replace_child (tree, parent, next, child);
+		if (parent == node)
+			parent = next;
+
+		*next = *node;
+		replace_child (tree, node->parent, node, next);
+		next->left->parent = next;
+		if (next->right != NULL)
+			next->right->parent = next;
+	} else {
+		child = node->left != NULL ? node->left : node->right;
+		parent = node->parent;
+		red = node->red;
+		if (child != NULL)
+			child->parent = parent;
+		replace_child (tree, parent, node, child);
+	}
+
+	/* Taking out a black node leaves its subtree one black node
+	   short. */
+	if (!red)
+		remove_fixup (tree, parent, child);
+}
+
+/* Returns true if TREE is empty, false otherwise. */
+bool
+rb_empty (const struct rb_tree *tree) {
+	return tree->root == NULL;
+}
+
+/* Returns the smallest node in TREE, or a null pointer if TREE is
+   empty. */
+struct rb_node *
+rb_first (const struct rb_tree *tree) {
+	return tree->first;
+}
+
+/* Returns the node that follows NODE in its tree, or a null
+   pointer if NODE is the largest. */
+struct rb_node *
+rb_next (const struct rb_node *node) {
+	if (node->right != NULL) {
+		node = node->right;
+		while (node->left != NULL)
+			node = node->left;
+		return (struct rb_node *) node;
+	}
+	while (node->parent != NULL && node == node->parent->right)
+		node = node->parent;
+	return node->parent;
+}
+
+/* Makes NEW take OLD's place as a child of PARENT, or as the root
+   of TREE if PARENT is null. */
+static void
+replace_child (struct rb_tree *tree, struct rb_node *parent,
+		struct rb_node *old, struct rb_node *new) {
+	if (parent == NULL)
+		tree->root = new;
+	else if (parent->left == old)
+		parent->left = new;
+	else
+		parent->right = new;
+}
+
+/* Rotates the subtree rooted at NODE to the left. */
+static void
+rotate_left (struct rb_tree *tree, struct rb_node *node) {
+	struct rb_node *right = node->right;
+
+	node->right = right->left;
+	if (right->left != NULL)
+		right->left->parent = node;
+	right->parent = node->parent;
+	replace_child (tree, node->parent, node, right);
+	right->left = node;
+	node->parent = right;
+}
+
+/* Rotates the subtree rooted at NODE to the right. */
+static void
+rotate_right (struct rb_tree *tree, struct rb_node *node) {
+	struct rb_node *left = node->left;
+
+	node->left = left->right;
+	if (left->right != NULL)
+		left->right->parent = node;
+	left->parent = node->parent;
+	replace_child (tree, node->parent, node, left);
+	left->right = node;
+	node->parent = left;
+}
+
+/* Restores the red-black properties after a black node was
+   removed from under PARENT, leaving NODE (possibly a leaf) in its
+   place with one black node too few on its paths. */
+static void
+remove_fixup (struct rb_tree *tree, struct rb_node *parent,
+		struct rb_node *node) {
+	while (!is_red (node) && node != tree->root) {
+		if (node == parent->left) {
+			struct rb_node *sibling = parent->right;
+			if (is_red (sibling)) {
+				sibling->red = false;
+				parent->red = true;
+				rotate_left (tree, parent);
+				sibling = parent->right;
+			}
+			if (!is_red (sibling->left) && !is_red (sibling->right)) {
+				sibling->red = true;
+				node = parent;
+				parent = node->parent;
+			} else {
+				if (!is_red (sibling->right)) {
+					sibling->left->red = false;
+					sibling->red = true;
+					rotate_right (tree, sibling);
+					sibling = parent->right;
+				}
+				sibling->red = parent->red;
+				parent->red = false;
+				if (sibling->right != NULL)
+					sibling->right->red = false;
+				rotate_left (tree, parent);
+				node = tree->root;
+				break;
+			}
+		} else {
+			struct rb_node *sibling = parent->left;
+			if (is_red (sibling)) {
+				sibling->red = false;
+				parent->red = true;
+				rotate_right (tree, parent);
+				sibling = parent->left;
+			}
+			if (!is_red (sibling->left) && !is_red (sibling->right)) {
+				sibling->red = true;
+				node = parent;
+				parent = node->parent;
+			} else {
+				if (!is_red (sibling->left)) {
+					sibling->right->red = false;
+					sibling->red = true;
+					rotate_left (tree, sibling);
+					sibling = parent->left;
+				}
+				sibling->red = parent->red;
+				parent->red = false;
+				if (sibling->left != NULL)
+					sibling->left->red = false;
+				rotate_right (tree, parent);
+				node = tree->root;
+				break;
+			}
+		}
+	}
+	if (node != NULL)
+		node->red = false;
+}
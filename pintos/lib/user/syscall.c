@@ -194,3 +194,18 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+bool
+diskstat (int chan_no, int dev_no, struct diskstat *stats) {
+	return syscall3 (SYS_DISKSTAT, chan_no, dev_no, stats);
+}
+
+int
+clock_gettime (clockid_t clock, struct timespec *ts) {
+	return syscall2 (SYS_CLOCK_GETTIME, clock, ts);
+}
+
+int
+lockstat (struct lockstat *stats, int max) {
+	return syscall2 (SYS_LOCKSTAT, stats, max);
+}
@@ -0,0 +1,147 @@
+/* Measures each kind of lock under contention.  THREAD_CNT
+   threads each run ITER_CNT critical sections that increment a
+   shared counter, yielding in the middle of the critical section
+   to force the other threads to contend for the lock.  The
+   reader-writer lock gets a read-mostly load instead: one
+   operation in WRITE_EVERY writes, the rest only read.
+
+   Prints the time each kind took and fails if any increment was
+   lost.  The times are for comparison, not for grading. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 8
+#define ITER_CNT 200
+#define WRITE_EVERY 8
+
+enum bench_kind
+  {
+    BENCH_LOCK,
+    BENCH_MUTEX,
+    BENCH_RWLOCK,
+    BENCH_SPINLOCK,
+  };
+
+static const char *kind_names[] = {"lock", "mutex", "rwlock", "spinlock"};
+
+static struct lock lock;
+static struct mutex mutex;
+static struct rwlock rwlock;
+static struct spinlock spinlock;
+
+static struct semaphore done;
+static volatile int counter;
+static enum bench_kind kind;
+
+static thread_func bench_thread;
+static void run_bench (enum bench_kind);
+
+void
+test_synch_bench (void)
+{
+  lock_init (&lock);
+  mutex_init (&mutex);
+  rwlock_init (&rwlock);
+  spin_init (&spinlock);
+
+  run_bench (BENCH_LOCK);
+  run_bench (BENCH_MUTEX);
+  run_bench (BENCH_RWLOCK);
+  run_bench (BENCH_SPINLOCK);
+}
+
+/* Runs THREAD_CNT threads contending for lock kind K and reports
+   how long they took. */
+static void
+run_bench (enum bench_kind k)
+{
+  int expected = THREAD_CNT * ITER_CNT;
+  int64_t start;
+  int i;
+
+  if (k == BENCH_RWLOCK)
+    expected = THREAD_CNT * ((ITER_CNT + WRITE_EVERY - 1) / WRITE_EVERY);
+
+  kind = k;
+  counter = 0;
+  sema_init (&done, 0);
+
+  start = timer_ns ();
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "%s %d", kind_names[k], i);
+      thread_create (name, PRI_DEFAULT, bench_thread, NULL);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  if (counter != expected)
+    fail ("%s: counter is %d, expected %d", kind_names[k], counter, expected);
+  msg ("%s: %d ops in %lld us, count ok",
+       kind_names[k], THREAD_CNT * ITER_CNT,
+       (long long) (timer_ns () - start) / 1000);
+}
+
+/* Increments COUNTER non-atomically, yielding between the read
+   and the write so that a broken lock would lose updates. */
+static void
+bump_counter (bool may_yield)
+{
+  int c = counter;
+  if (may_yield)
+    thread_yield ();
+  counter = c + 1;
+}
+
+static void
+bench_thread (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++)
+    switch (kind)
+      {
+      case BENCH_LOCK:
+        lock_acquire (&lock);
+        bump_counter (true);
+        lock_release (&lock);
+        break;
+
+      case BENCH_MUTEX:
+        mutex_acquire (&mutex);
+        bump_counter (true);
+        mutex_release (&mutex);
+        break;
+
+      case BENCH_RWLOCK:
+        if (i % WRITE_EVERY == 0)
+          {
+            rwlock_acquire_write (&rwlock);
+            bump_counter (true);
+            rwlock_release_write (&rwlock);
+          }
+        else
+          {
+            rwlock_acquire_read (&rwlock);
+            thread_yield ();
+            rwlock_release_read (&rwlock);
+          }
+        break;
+
+      case BENCH_SPINLOCK:
+        /* Interrupts are off while a spinlock is held, so the
+           critical section must not yield. */
+        spin_lock (&spinlock);
+        bump_counter (false);
+        spin_unlock (&spinlock);
+        thread_yield ();
+        break;
+      }
+  sema_up (&done);
+}
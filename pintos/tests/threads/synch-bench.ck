@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+foreach my $kind ('lock', 'mutex', 'rwlock', 'spinlock') {
+    fail "missing result for $kind"
+      unless grep (/^\(synch-bench\) $kind: \d+ ops in \d+ us, count ok$/,
+		   @output);
+}
+
+pass;
@@ -0,0 +1,68 @@
+/* Dirties two pages of a file through a mapping and unmaps it,
+   so that both pages are handed to the page cache for writeback.
+   Then overwrites the second page with the write system call and
+   verifies that neither read() nor a fresh mapping ever sees the
+   stale mapped data win over the later write. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+#define PAGE_SIZE 4096
+
+static char buf[PAGE_SIZE * 2];
+
+static void
+check_contents (const char *what)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof buf; i++)
+    {
+      char expected = i < PAGE_SIZE ? 'a' : 'c';
+      if (buf[i] != expected)
+        fail ("%s: byte %zu is '%c', expected '%c'",
+              what, i, buf[i], expected);
+    }
+  msg ("%s matches", what);
+}
+
+void
+test_main (void)
+{
+  int handle;
+  void *map;
+
+  CHECK (create ("order.txt", sizeof buf), "create \"order.txt\"");
+  CHECK ((handle = open ("order.txt")) > 1, "open \"order.txt\"");
+
+  /* Dirty both pages through a mapping, then unmap. */
+  CHECK ((map = mmap (ACTUAL, sizeof buf, 1, handle, 0)) != MAP_FAILED,
+         "mmap \"order.txt\"");
+  memset (ACTUAL, 'a', PAGE_SIZE);
+  memset ((char *) ACTUAL + PAGE_SIZE, 'b', PAGE_SIZE);
+  munmap (map);
+
+  /* Overwrite the second page with write(). */
+  memset (buf, 'c', PAGE_SIZE);
+  seek (handle, PAGE_SIZE);
+  CHECK (write (handle, buf, PAGE_SIZE) == PAGE_SIZE, "write second page");
+
+  /* Read back via read(). */
+  memset (buf, 0, sizeof buf);
+  seek (handle, 0);
+  CHECK (read (handle, buf, sizeof buf) == (int) sizeof buf,
+         "read \"order.txt\"");
+  check_contents ("read data");
+
+  /* Read back via a new mapping. */
+  CHECK ((map = mmap (ACTUAL, sizeof buf, 0, handle, 0)) != MAP_FAILED,
+         "mmap \"order.txt\" again");
+  memcpy (buf, ACTUAL, sizeof buf);
+  munmap (map);
+  check_contents ("mapped data");
+
+  close (handle);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-wb-order) begin
+(mmap-wb-order) create "order.txt"
+(mmap-wb-order) open "order.txt"
+(mmap-wb-order) mmap "order.txt"
+(mmap-wb-order) write second page
+(mmap-wb-order) read "order.txt"
+(mmap-wb-order) read data matches
+(mmap-wb-order) mmap "order.txt" again
+(mmap-wb-order) mapped data matches
+(mmap-wb-order) end
+EOF
+pass;
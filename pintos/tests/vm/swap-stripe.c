@@ -0,0 +1,47 @@
+/* Checks that swap striped over two disks keeps every page's
+   contents.  The test runs with two swap disks that are each too
+   small to hold the working set alone, so it only passes if
+   evicted pages land on, and come back from, both disks.
+   Each page is tagged at both ends with its index so that a
+   page read back from the wrong slot or disk is detected. */
+
+#include <string.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1 << PAGE_SHIFT)
+#define ONE_MB (1 << 20) // 1MB
+#define CHUNK_SIZE (20*ONE_MB)
+#define PAGE_COUNT (CHUNK_SIZE / PAGE_SIZE)
+
+static char big_chunks[CHUNK_SIZE];
+
+void
+test_main (void) 
+{
+  size_t i;
+  size_t *head, *tail;
+
+  for (i = 0; i < PAGE_COUNT; i++)
+    {
+      if (!(i % 1024))
+        msg ("tag page %zu", i);
+      head = (size_t *) (big_chunks + i * PAGE_SIZE);
+      tail = (size_t *) (big_chunks + (i + 1) * PAGE_SIZE) - 1;
+      *head = i;
+      *tail = ~i;
+    }
+
+  for (i = 0; i < PAGE_COUNT; i++)
+    {
+      head = (size_t *) (big_chunks + i * PAGE_SIZE);
+      tail = (size_t *) (big_chunks + (i + 1) * PAGE_SIZE) - 1;
+      if (*head != i || *tail != ~i)
+        fail ("page %zu is inconsistent", i);
+      if (!(i % 1024))
+        msg ("check page %zu", i);
+    }
+}
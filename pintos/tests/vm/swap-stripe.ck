@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "swap was not striped over both disks\n"
+  if !grep (/swap: \d+ slots striped over 2 disks/, @output);
+
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-stripe) begin
+(swap-stripe) tag page 0
+(swap-stripe) tag page 1024
+(swap-stripe) tag page 2048
+(swap-stripe) tag page 3072
+(swap-stripe) tag page 4096
+(swap-stripe) check page 0
+(swap-stripe) check page 1024
+(swap-stripe) check page 2048
+(swap-stripe) check page 3072
+(swap-stripe) check page 4096
+(swap-stripe) end
+EOF
+pass;
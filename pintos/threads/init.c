@@ -19,8 +19,10 @@
 #include "threads/malloc.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
+#include "threads/profile.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -105,6 +107,8 @@ main (void) {
 	thread_start ();
 	serial_init_queue ();
 	timer_calibrate ();
+	profile_init ();
+	trace_init ();
 
 #ifdef FILESYS
 	/* Initialize file system. */
@@ -221,15 +225,31 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-cfs"))
+			thread_cfs = true;
+		else if (!strcmp (name, "-profile"))
+			profile_hz = value != NULL ? atoi (value) : 1000;
+		else if (!strcmp (name, "-trace"))
+			trace_enabled = true;
+		else if (!strcmp (name, "-novga"))
+			console_disable_vga ();
+		else if (!strcmp (name, "-icanon"))
+			input_set_canonical ();
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-swap"))
+			swap_disks_option = value;
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
 	}
+	if (thread_mlfqs && thread_cfs)
+		PANIC ("-mlfqs and -cfs cannot be used together");
 
 	return argv;
 }
@@ -326,8 +346,17 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -cfs               Use fair-share (weighted virtual runtime) scheduler.\n"
+			"  -profile[=HZ]      Sample where the CPU runs, HZ times a second\n"
+			"                     (default 1000), and print the samples at power off.\n"
+			"  -trace             Record scheduler events and print them at power off.\n"
+			"  -novga             Send console output to the serial port only.\n"
+			"  -icanon            Read console input a line at a time, with echo.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -swap=C:D[,C:D...] Stripe swap over these disks (default 1:1).\n"
 #endif
 			);
 	power_off ();
@@ -354,6 +383,9 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	lock_print_stats ();
+	profile_print_stats ();
+	trace_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
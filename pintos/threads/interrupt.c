@@ -12,6 +12,7 @@
 #include "threads/io.h"
 #include "threads/mmu.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
 
 #ifdef USERPROG
@@ -250,6 +251,7 @@ bool intr_context(void) { return in_external_intr; }
    time. */
 void intr_yield_on_return(void) {
   ASSERT(intr_context());
+  if (!yield_on_return) trace_preempt();
   yield_on_return = true;
 }
 
@@ -337,7 +337,7 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
 	uint64_t pgcnt = (end - start) / PGSIZE;
 	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
 
-	lock_init(&p->lock);
+	lock_init_named(&p->lock, "palloc_pool");
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
 	p->base = (void *) start;
 
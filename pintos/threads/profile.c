@@ -0,0 +1,101 @@
+#include "threads/profile.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A statistical CPU profiler.  The RTC interrupt hands us the
+   interrupted frame about profile_hz times per second, and we
+   record where it was running: for kernel code the instruction
+   pointer plus a short backtrace along the saved frame pointers
+   (the kernel is built with -fno-omit-frame-pointer), for user
+   code the instruction pointer only.  Samples go into a ring that
+   keeps the most recent PROFILE_SAMPLES of them. */
+
+#define PROFILE_DEPTH 6  /* Callers kept per kernel sample. */
+#define PROFILE_PAGES 64 /* Size of the ring, in pages. */
+
+struct profile_sample {
+  uint64_t rip;                    /* Interrupted instruction. */
+  bool user;                       /* Was it in user mode? */
+  uint8_t depth;                   /* Entries in FRAMES. */
+  uint64_t frames[PROFILE_DEPTH];  /* Return addresses, innermost first. */
+};
+
+#define PROFILE_SAMPLES (PROFILE_PAGES * PGSIZE / sizeof(struct profile_sample))
+
+/* Requested sampling rate, or 0 if the profiler is off.  Set by
+   "-profile[=HZ]" and replaced by the actual rate. */
+int profile_hz;
+
+static struct profile_sample *samples;  // PROFILE_SAMPLES개짜리 ring
+static uint64_t sample_cnt;             // 지금까지 찍은 샘플 수 (ring에 남은 것보다 많을 수 있다)
+static bool frozen;                     // 출력 중에는 ring을 건드리지 않는다
+
+static void profile_sample(struct intr_frame *f);
+
+/* Allocates the sample ring and starts sampling, if the profiler
+   was enabled on the command line.  Call once the timer and page
+   allocator are up. */
+void profile_init(void) {
+  if (profile_hz <= 0) return;
+
+  samples = palloc_get_multiple(0, PROFILE_PAGES);
+  if (samples == NULL) {
+    printf("Profiler disabled: no memory for samples.\n");
+    profile_hz = 0;
+    return;
+  }
+  profile_hz = timer_start_sampling(profile_sample, profile_hz);
+  printf("Profiling at %d Hz.\n", profile_hz);
+}
+
+/* Records one sample of the code that F interrupted.  Runs in the
+   RTC interrupt handler. */
+static void profile_sample(struct intr_frame *f) {
+  if (frozen) return;
+
+  struct profile_sample *s = &samples[sample_cnt++ % PROFILE_SAMPLES];
+
+  s->rip = f->rip;
+  s->depth = 0;
+  s->user = (f->cs & 3) == 3;
+  if (s->user) return;  // 유저 스택은 믿을 수 없으니 rip만 남긴다
+
+  /* 인터럽트된 커널 코드도 F와 같은 커널 스택 페이지 위에 있다.
+     frame pointer가 그 페이지 안에서 위로만 올라갈 때만 따라간다. */
+  uintptr_t page = (uintptr_t)pg_round_down(f);
+  uintptr_t prev = (uintptr_t)f;
+  uintptr_t fp = f->R.rbp;
+  while (s->depth < PROFILE_DEPTH && fp > prev && fp + 2 * sizeof(uint64_t) <= page + PGSIZE) {
+    const uint64_t *frame = (const uint64_t *)fp;
+    if (frame[1] == 0) break;
+    s->frames[s->depth++] = frame[1];
+    prev = fp;
+    fp = frame[0];
+  }
+}
+
+/* Prints the samples still in the ring, oldest first, one per
+   line: "Profile: k RIP CALLER..." for kernel code or
+   "Profile: u RIP" for user code. */
+void profile_print_stats(void) {
+  if (samples == NULL) return;
+
+  frozen = true;  // 출력하는 동안 ring이 바뀌지 않도록 샘플링을 멈춘다
+  barrier();
+  uint64_t kept = sample_cnt < PROFILE_SAMPLES ? sample_cnt : PROFILE_SAMPLES;
+  printf("Profile: %" PRIu64 " samples at %d Hz, %" PRIu64 " kept\n", sample_cnt, profile_hz, kept);
+  for (uint64_t i = sample_cnt - kept; i < sample_cnt; i++) {
+    const struct profile_sample *s = &samples[i % PROFILE_SAMPLES];
+    printf("Profile: %c %#" PRIx64, s->user ? 'u' : 'k', s->rip);
+    for (int d = 0; d < s->depth; d++) printf(" %#" PRIx64, s->frames[d]);
+    printf("\n");
+  }
+}
@@ -28,11 +28,71 @@
 
 #include "threads/synch.h"
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "intrinsic.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+
+/* Semaphores and condition variables keep their waiters in a
+   pairing heap ordered by priority, so waking the highest-priority
+   waiter costs O(log n) instead of a scan of every waiter.  Ties
+   go to the thread that started waiting first. */
+
+static int64_t next_wait_seq;  // 대기 순번, 대기를 시작할 때마다 증가
+
+/* Returns true if waiter A should wake up before waiter B. */
+static bool waiter_less(const struct heap_elem *a_, const struct heap_elem *b_, void *aux UNUSED) {
+  const struct thread *a = heap_entry(a_, struct thread, wait_elem);
+  const struct thread *b = heap_entry(b_, struct thread, wait_elem);
+
+  if (a->priority != b->priority) return a->priority > b->priority;
+  return a->wait_seq < b->wait_seq;
+}
+
+/* Adds T to WAITERS.  Interrupts must be off. */
+static void waiter_push(struct heap *waiters, struct thread *t) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  t->wait_seq = next_wait_seq++;
+  t->wait_queue = waiters;
+  heap_push(waiters, &t->wait_elem);
+}
+
+/* Removes and returns the highest-priority thread in WAITERS,
+   which must not be empty.  Interrupts must be off. */
+static struct thread *waiter_pop(struct heap *waiters) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  struct thread *t = heap_entry(heap_pop(waiters), struct thread, wait_elem);
+  t->wait_queue = NULL;
+  return t;
+}
+
+/* Returns the highest priority in WAITERS, or -1 if it is
+   empty. */
+static int waiter_max_priority(const struct heap *waiters) {
+  if (heap_empty(waiters)) return -1;
+  return heap_entry(heap_top(waiters), struct thread, wait_elem)->priority;
+}
+
+/* Moves T, which is waiting on a semaphore or condition variable,
+   to its place among the other waiters after its priority changed
+   from OLD_PRIORITY.  Interrupts must be off. */
+void synch_priority_changed(struct thread *t, int old_priority) {
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(t->wait_queue != NULL);
+
+  if (t->priority > old_priority)  // donation처럼 올라간 경우는 제자리에서 O(1)
+    heap_raise(t->wait_queue, &t->wait_elem);
+  else if (t->priority < old_priority) {
+    heap_remove(t->wait_queue, &t->wait_elem);
+    heap_push(t->wait_queue, &t->wait_elem);
+  }
+}
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -47,7 +107,7 @@ void sema_init(struct semaphore *sema, unsigned value) {
   ASSERT(sema != NULL);
 
   sema->value = value;
-  list_init(&sema->waiters);
+  heap_init(&sema->waiters, waiter_less, NULL);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -65,8 +125,8 @@ void sema_down(struct semaphore *sema) {
   ASSERT(!intr_context());
 
   old_level = intr_disable();
-  while (sema->value == 0) {  // sema_up에서 최댓값을 가져오므로 넣을때는 끝에서부터 걍 넣자
-    list_push_back(&sema->waiters, &thread_current()->elem);
+  while (sema->value == 0) {  // 우선순위 heap에 넣고 잠든다
+    waiter_push(&sema->waiters, thread_current());
 
     thread_block();
   }
@@ -108,13 +168,8 @@ void sema_up(struct semaphore *sema) {
   old_level = intr_disable();
 
   sema->value++;  // good
-  if (!list_empty(&sema->waiters)) {
-    // sema->waiters 중에서 우선순위 최댓값인거 가져와야 함. 비교함수가 반대여서 min을 씀...(최댓값뽑는게맞음)
-    struct list_elem *max_elem = list_min(&sema->waiters, thread_priority_less, NULL);
-    struct thread *t = list_entry(max_elem, struct thread, elem);
-    list_remove(max_elem);  // 삭제까지 해줘야함 원래 pop이었으니까
-    thread_unblock(t);
-  }
+  if (!heap_empty(&sema->waiters))  // heap의 top이 우선순위가 가장 높은 대기자
+    thread_unblock(waiter_pop(&sema->waiters));
   intr_set_level(old_level);
 }
 
@@ -149,6 +204,145 @@ static void sema_test_helper(void *sema_) {
   }
 }
 
+/* Lock contention statistics, compiled in with -DLOCK_STATS
+   (`make LOCK_STATS=1').  Locks are grouped into classes by the
+   name given to lock_init_named(), or by where lock_init() was
+   called, so that e.g. every inode lock is counted together. */
+#ifdef LOCK_STATS
+static struct lockstat lock_classes[LOCKSTAT_MAX];
+static int lock_class_cnt;
+
+/* Returns the class of locks named NAME, or if NAME is null of
+   unnamed locks initialized at INIT_RIP, creating it if needed.
+   Returns NULL if the class table is full. */
+static struct lockstat *lock_class_get(const char *name, uint64_t init_rip) {
+  char key[LOCKSTAT_NAME_LEN] = "";
+  struct lockstat *c;
+
+  if (name != NULL) strlcpy(key, name, sizeof key);  // 저장된 이름과 같은 길이로 잘라서 비교
+  for (c = lock_classes; c < lock_classes + lock_class_cnt; c++)
+    if (name != NULL ? strcmp(c->name, key) == 0 : c->name[0] == '\0' && c->init_rip == init_rip) return c;
+  if (lock_class_cnt >= LOCKSTAT_MAX) return NULL;  // 가득 차면 더 이상 세지 않는다
+
+  c = &lock_classes[lock_class_cnt++];
+  strlcpy(c->name, key, sizeof c->name);
+  c->init_rip = init_rip;
+  return c;
+}
+
+static void lock_stats_init(struct lock *lock, const char *name, void *init_rip) {
+  enum intr_level old_level = intr_disable();
+  lock->stats = lock_class_get(name, (uint64_t)init_rip);
+  if (lock->stats != NULL) lock->stats->locks++;
+  intr_set_level(old_level);
+}
+
+static inline uint64_t lock_stats_now(void) { return rdtsc(); }
+
+/* Charges a wait of WAIT cycles to call site RIP of class C.  A
+   site not yet recorded replaces the one that has waited least,
+   if it waited longer than that. */
+static void lock_stats_note_waiter(struct lockstat *c, uint64_t rip, uint64_t wait) {
+  struct lockstat_waiter *victim = &c->waiters[0];
+
+  for (struct lockstat_waiter *w = c->waiters; w < c->waiters + LOCKSTAT_WAITERS; w++) {
+    if (w->rip == rip) {
+      w->count++;
+      w->wait_cycles += wait;
+      return;
+    }
+    if (w->wait_cycles < victim->wait_cycles) victim = w;
+  }
+  if (victim->rip != 0 && victim->wait_cycles > wait) return;
+
+  victim->rip = rip;
+  victim->count = 1;
+  victim->wait_cycles = wait;
+}
+
+/* Records that LOCK was just acquired by WAITER, the caller of
+   lock_acquire().  WAIT_START is when it started waiting, or 0 if
+   the lock was free.  Interrupts must be off. */
+static void lock_stats_acquired(struct lock *lock, uint64_t wait_start, void *waiter) {
+  struct lockstat *c = lock->stats;
+  uint64_t now = rdtsc();
+
+  lock->acquired_tsc = now;
+  if (c == NULL) return;
+  c->acquisitions++;
+  if (wait_start == 0) return;
+
+  uint64_t wait = now - wait_start;
+  c->contended++;
+  c->wait_cycles += wait;
+  if (wait > c->max_wait_cycles) c->max_wait_cycles = wait;
+  lock_stats_note_waiter(c, (uint64_t)waiter, wait);
+}
+
+/* Records that LOCK is being released.  Interrupts must be off. */
+static void lock_stats_released(struct lock *lock) {
+  struct lockstat *c = lock->stats;
+  if (c == NULL) return;
+
+  uint64_t hold = rdtsc() - lock->acquired_tsc;
+  c->hold_cycles += hold;
+  if (hold > c->max_hold_cycles) c->max_hold_cycles = hold;
+}
+
+/* Copies the statistics of up to MAX lock classes into BUF and
+   returns how many it copied, or -1 if the kernel was built
+   without lock statistics. */
+int lock_stats(struct lockstat *buf, int max) {
+  enum intr_level old_level = intr_disable();
+  int n = lock_class_cnt < max ? lock_class_cnt : max;
+  memcpy(buf, lock_classes, n * sizeof *buf);
+  intr_set_level(old_level);
+  return n;
+}
+
+/* Prints statistics for every lock class that was acquired, the
+   ones that waited longest in total first. */
+void lock_print_stats(void) {
+  static struct lockstat snap[LOCKSTAT_MAX];  // 스택에 두기엔 크다
+  int n = lock_stats(snap, LOCKSTAT_MAX);
+
+  for (int i = 1; i < n; i++) {  // 총 대기 시간 내림차순 삽입 정렬
+    struct lockstat s = snap[i];
+    int j;
+    for (j = i; j > 0 && snap[j - 1].wait_cycles < s.wait_cycles; j--) snap[j] = snap[j - 1];
+    snap[j] = s;
+  }
+
+  for (struct lockstat *s = snap; s < snap + n; s++) {
+    char name[LOCKSTAT_NAME_LEN + 8];
+    if (s->acquisitions == 0) continue;
+    if (s->name[0] != '\0')
+      strlcpy(name, s->name, sizeof name);
+    else
+      snprintf(name, sizeof name, "lock@%#" PRIx64, s->init_rip);  // utils/backtrace로 위치를 찾을 수 있다
+
+    printf("Lock %s: %" PRIu64 " acquired, %" PRIu64 " contended, %" PRIu64 " cycles waited (max %" PRIu64
+           "), %" PRIu64 " cycles held (max %" PRIu64 ")\n",
+           name, s->acquisitions, s->contended, s->wait_cycles, s->max_wait_cycles, s->hold_cycles,
+           s->max_hold_cycles);
+    for (struct lockstat_waiter *w = s->waiters; w < s->waiters + LOCKSTAT_WAITERS; w++)
+      if (w->rip != 0)
+        printf("Lock %s: waiter %#" PRIx64 ": %" PRIu64 " times, %" PRIu64 " cycles\n", name, w->rip, w->count,
+               w->wait_cycles);
+  }
+}
+#else
+static inline void lock_stats_init(struct lock *lock UNUSED, const char *name UNUSED, void *init_rip UNUSED) {}
+static inline uint64_t lock_stats_now(void) { return 0; }
+static inline void lock_stats_acquired(struct lock *lock UNUSED, uint64_t wait_start UNUSED, void *waiter UNUSED) {}
+static inline void lock_stats_released(struct lock *lock UNUSED) {}
+
+int lock_stats(struct lockstat *buf UNUSED, int max UNUSED) { return -1; }
+void lock_print_stats(void) {}
+#endif
+
+static void lock_init_common(struct lock *lock, const char *name, void *init_rip);
+
 /* Initializes LOCK.  A lock can be held by at most a single
    thread at any given time.  Our locks are not "recursive", that
    is, it is an error for the thread currently holding a lock to
@@ -167,8 +361,22 @@ static void sema_test_helper(void *sema_) {
 void lock_init(struct lock *lock) {
   ASSERT(lock != NULL);
 
+  lock_init_common(lock, NULL, __builtin_return_address(0));
+}
+
+/* Initializes LOCK like lock_init(), naming it NAME for lock
+   statistics.  Locks with the same name are counted together. */
+void lock_init_named(struct lock *lock, const char *name) {
+  ASSERT(lock != NULL);
+  ASSERT(name != NULL);
+
+  lock_init_common(lock, name, __builtin_return_address(0));
+}
+
+static void lock_init_common(struct lock *lock, const char *name, void *init_rip) {
   lock->holder = NULL;
   sema_init(&lock->semaphore, 1);
+  lock_stats_init(lock, name, init_rip);
 }
 
 static void donate_priority_dfs(struct thread *holder, int prioirty);
@@ -187,6 +395,11 @@ void lock_acquire(struct lock *lock) {  // P 함수의 wrapper, 해당 락을 
 
   enum intr_level old_level = intr_disable();
   struct thread *curr = thread_current();
+  bool contended = lock->holder != NULL;
+  uint64_t wait_start = lock_stats_now();
+
+  // donate 이벤트보다 먼저 기록해야 sched-trace가 이 대기를 inversion으로 셈
+  if (contended) trace_lock_wait(lock);
 
   // priority donate nested
   if (lock->holder != NULL) {
@@ -204,7 +417,9 @@ void lock_acquire(struct lock *lock) {  // P 함수의 wrapper, 해당 락을 
   lock->holder = curr;            // 만약 뚫었다면 현재 스레드가 이 lock의 holder임
   curr->is_donated += 1;          // 내가 락을 소유하게 되었으니 is_donated 추가
   list_push_back(&curr->acquired_locks, &lock->holder_elem);  // 보유중인 락에 추가 이건 순서 상관없음
-  intr_set_level(old_level);                                  // 인터럽트 복원
+  lock_stats_acquired(lock, contended ? wait_start : 0, __builtin_return_address(0));
+  if (contended) trace_lock_acquired(lock);
+  intr_set_level(old_level);  // 인터럽트 복원
 }
 static void donate_priority_dfs(struct thread *holder, int prioirty) {
   int depth = 0;
@@ -222,14 +437,9 @@ static void donate_priority_dfs(struct thread *holder, int prioirty) {
     if (curr->priority >= prioirty)  //우선순위가 이미 높거나 같다면
       break;                         //중단
 
-    // priority donation 수행
-    curr->priority = prioirty;
-
-    // ready_list에 있다면 재정렬
-    if (curr->status == THREAD_READY) {
-      list_remove(&curr->elem);
-      list_insert_ordered(get_ready_list(), &curr->elem, thread_priority_less, NULL);
-    }
+    // priority donation 수행, ready 상태라면 새 우선순위의 큐로 옮김
+    trace_donate(curr, prioirty);
+    thread_requeue(curr, prioirty);
 
     // 다음 체인 확인 : 이 스레드가 다른 락을 기다리고 있는가
     if (curr->waiting_for_lock == NULL) {  // 다른 락을 기다리고 있지 않다면
@@ -253,8 +463,16 @@ bool lock_try_acquire(struct lock *lock) {
   ASSERT(lock != NULL);
   ASSERT(!lock_held_by_current_thread(lock));
 
+  enum intr_level old_level = intr_disable();
   success = sema_try_down(&lock->semaphore);
-  if (success) lock->holder = thread_current();
+  if (success) {  // lock_acquire와 똑같이 보유 락 목록에 올려야 lock_release가 정리할 수 있다
+    struct thread *curr = thread_current();
+    lock->holder = curr;
+    curr->is_donated += 1;
+    list_push_back(&curr->acquired_locks, &lock->holder_elem);
+    lock_stats_acquired(lock, 0, NULL);
+  }
+  intr_set_level(old_level);
   return success;
 }
 
@@ -273,6 +491,7 @@ void lock_release(struct lock *lock) {  // V함수의 wrapper
 
   //현재 쓰레드의 acquired locks에서 노드 제거
   list_remove(&lock->holder_elem);
+  lock_stats_released(lock);
 
   // 우선순위 복구 내가 가지고 있는 acquire lock 중에서 가장 큰 걸로 받아와야함
   int new_priority = curr->original_priority;
@@ -282,15 +501,12 @@ void lock_release(struct lock *lock) {  // V함수의 wrapper
   // 그걸로 채택)
   for (e = list_begin(&curr->acquired_locks); e != list_end(&curr->acquired_locks); e = list_next(e)) {
     struct lock *other_lock = list_entry(e, struct lock, holder_elem);
+    int waiter_priority = waiter_max_priority(&other_lock->semaphore.waiters);  // 대기자가 없으면 -1
 
-    if (list_empty(&other_lock->semaphore.waiters)) continue;  // 대기자가 없는 락은 pass
-
-    struct thread *front_thread = list_entry(list_front(&other_lock->semaphore.waiters), struct thread, elem);
-
-    if (front_thread->priority > new_priority)  // 각 락의 우선순위 최댓값을 가지고 new_priority 갱신
-      new_priority = front_thread->priority;
+    if (waiter_priority > new_priority)  // 각 락의 우선순위 최댓값을 가지고 new_priority 갱신
+      new_priority = waiter_priority;
   }
-  curr->priority = new_priority;  // 현재 스레드의 적절한 priority로 갱신
+  thread_requeue(curr, new_priority);  // 현재 스레드의 적절한 priority로 갱신 (cond_wait 중이면 waiter heap 안에 있다)
   curr->is_donated -= 1;          // 내가 풀었으니까 is_donated 하나 내리기
 
   lock->holder = NULL;
@@ -307,11 +523,193 @@ bool lock_held_by_current_thread(const struct lock *lock) {
   return lock->holder == thread_current();
 }
 
-/* One semaphore in a list. */
-struct semaphore_elem {
-  struct list_elem elem;      /* List element. */
-  struct semaphore semaphore; /* This semaphore. */
-};
+/* Atomically stores NEW in *P and returns the old value. */
+static inline int atomic_xchg(volatile int *p, int new) {
+  asm volatile("xchgl %0, %1" : "+r"(new), "+m"(*p) : : "memory");
+  return new;
+}
+
+/* Initializes spinlock SL as free. */
+void spin_init(struct spinlock *sl) {
+  ASSERT(sl != NULL);
+
+  sl->locked = 0;
+  sl->holder = NULL;
+}
+
+/* Acquires spinlock SL, disabling interrupts until spin_unlock().
+   With a single CPU and interrupts off nobody else can hold SL,
+   so the loop only ever spins on a multiprocessor. */
+void spin_lock(struct spinlock *sl) {
+  ASSERT(sl != NULL);
+
+  enum intr_level old_level = intr_disable();
+  ASSERT(!spin_held_by_current_thread(sl));
+  while (atomic_xchg(&sl->locked, 1) != 0)
+    while (sl->locked) asm volatile("pause");
+  sl->holder = thread_current();
+  sl->old_level = old_level;
+}
+
+/* Tries to acquire spinlock SL without spinning.  Returns true if
+   successful, in which case interrupts are off until
+   spin_unlock(). */
+bool spin_trylock(struct spinlock *sl) {
+  ASSERT(sl != NULL);
+
+  enum intr_level old_level = intr_disable();
+  if (atomic_xchg(&sl->locked, 1) != 0) {
+    intr_set_level(old_level);
+    return false;
+  }
+  sl->holder = thread_current();
+  sl->old_level = old_level;
+  return true;
+}
+
+/* Releases spinlock SL, which the current thread must hold, and
+   restores the interrupt level from before it was acquired. */
+void spin_unlock(struct spinlock *sl) {
+  ASSERT(spin_held_by_current_thread(sl));
+
+  enum intr_level old_level = sl->old_level;
+  sl->holder = NULL;
+  atomic_xchg(&sl->locked, 0);
+  intr_set_level(old_level);
+}
+
+/* Returns true if the current thread holds SL. */
+bool spin_held_by_current_thread(const struct spinlock *sl) {
+  ASSERT(sl != NULL);
+
+  return sl->locked && sl->holder == thread_current();
+}
+
+/* Initializes RW as a reader-writer lock that nobody holds.
+
+   A writer holds RW->gate for as long as it writes, so waiting
+   readers and writers queue up on the gate in priority order and
+   donate their priority to the writer.  A reader only passes
+   through the gate on the way in.  Readers receive no donation: a
+   writer waiting for them to leave waits at their priority.  Read
+   locks do not nest, since a second read_acquire would wait behind
+   any writer that arrived in between. */
+void rwlock_init(struct rwlock *rw) {
+  ASSERT(rw != NULL);
+
+  lock_init(&rw->gate);
+  rw->readers = 0;
+  rw->drainer = NULL;
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   is waiting for it. */
+void rwlock_acquire_read(struct rwlock *rw) {
+  ASSERT(rw != NULL);
+  ASSERT(!intr_context());
+
+  lock_acquire(&rw->gate);  // writer가 있거나 기다리는 중이면 여기서 막힌다
+  enum intr_level old_level = intr_disable();
+  rw->readers++;
+  intr_set_level(old_level);
+  lock_release(&rw->gate);
+}
+
+/* Releases RW, which the current thread holds for reading. */
+void rwlock_release_read(struct rwlock *rw) {
+  ASSERT(rw != NULL);
+
+  enum intr_level old_level = intr_disable();
+  ASSERT(rw->readers > 0);
+  if (--rw->readers == 0 && rw->drainer != NULL) {  // 마지막 reader가 기다리는 writer를 깨운다
+    thread_unblock(rw->drainer);
+    rw->drainer = NULL;
+  }
+  intr_set_level(old_level);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it. */
+void rwlock_acquire_write(struct rwlock *rw) {
+  ASSERT(rw != NULL);
+  ASSERT(!intr_context());
+
+  lock_acquire(&rw->gate);  // 이후로 새 reader는 들어오지 못한다
+  enum intr_level old_level = intr_disable();
+  while (rw->readers > 0) {  // 이미 들어와 있는 reader들이 나갈 때까지 대기
+    rw->drainer = thread_current();
+    thread_block();
+  }
+  intr_set_level(old_level);
+}
+
+/* Releases RW, which the current thread holds for writing. */
+void rwlock_release_write(struct rwlock *rw) {
+  ASSERT(rwlock_held_for_write(rw));
+
+  lock_release(&rw->gate);
+}
+
+/* Returns true if the current thread holds RW for writing. */
+bool rwlock_held_for_write(const struct rwlock *rw) {
+  ASSERT(rw != NULL);
+
+  return lock_held_by_current_thread(&rw->gate) && rw->readers == 0;
+}
+
+/* Iterations mutex_acquire() spins before it sleeps. */
+#define MUTEX_SPIN_LIMIT 100
+
+/* Initializes adaptive mutex M. */
+void mutex_init(struct mutex *m) {
+  ASSERT(m != NULL);
+
+  lock_init(&m->lock);
+}
+
+/* Acquires M.  While M's holder is running on another CPU it is
+   likely to release M soon, so we spin up to MUTEX_SPIN_LIMIT
+   times rather than pay for sleeping and waking up.  If the holder
+   is not running, spinning cannot help and we sleep right away;
+   with one CPU that is always the case.  Sleeping goes through
+   lock_acquire(), so the holder still receives our priority. */
+void mutex_acquire(struct mutex *m) {
+  ASSERT(m != NULL);
+  ASSERT(!intr_context());
+
+  for (int i = 0; i < MUTEX_SPIN_LIMIT; i++) {
+    if (lock_try_acquire(&m->lock)) return;
+
+    enum intr_level old_level = intr_disable();
+    struct thread *holder = m->lock.holder;
+    bool holder_running = holder != NULL && holder->status == THREAD_RUNNING;
+    intr_set_level(old_level);
+    if (holder != NULL && !holder_running) break;  // 실행 중이 아닌 holder를 기다리며 도는 것은 낭비
+    asm volatile("pause");
+  }
+  lock_acquire(&m->lock);
+}
+
+/* Tries to acquire M without sleeping or spinning. */
+bool mutex_try_acquire(struct mutex *m) {
+  ASSERT(m != NULL);
+
+  return lock_try_acquire(&m->lock);
+}
+
+/* Releases M, which the current thread must hold. */
+void mutex_release(struct mutex *m) {
+  ASSERT(m != NULL);
+
+  lock_release(&m->lock);
+}
+
+/* Returns true if the current thread holds M. */
+bool mutex_held_by_current_thread(const struct mutex *m) {
+  ASSERT(m != NULL);
+
+  return lock_held_by_current_thread(&m->lock);
+}
 
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
@@ -319,7 +717,7 @@ struct semaphore_elem {
 void cond_init(struct condition *cond) {
   ASSERT(cond != NULL);
 
-  list_init(&cond->waiters);
+  heap_init(&cond->waiters, waiter_less, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -343,18 +741,21 @@ void cond_init(struct condition *cond) {
    interrupts disabled, but interrupts will be turned back on if
    we need to sleep. */
 void cond_wait(struct condition *cond, struct lock *lock) {  // 특정 조건에 의해서 대기
-  struct semaphore_elem waiter;                              // 해당 조건을 기다릴 thread 전용 semaphore
+  struct thread *curr = thread_current();
 
   ASSERT(cond != NULL);
   ASSERT(lock != NULL);
   ASSERT(!intr_context());
   ASSERT(lock_held_by_current_thread(lock));
 
-  sema_init(&waiter.semaphore, 0);               // 새로만든 semaphore_elem을 초기화한다.
-  list_push_back(&cond->waiters, &waiter.elem);  // 새로만든 semaphore 를 cond에 추가한다.
-  lock_release(lock);  // 다른 사람이 들어올 수 있도록 lock을 열어 둔다(원자적 이동을 보장하기 위함)
-  sema_down(&waiter.semaphore);  // 내 전용 semaphore가 풀릴 때까지 대기한다.(cond_signal이 풀어줌)
-  lock_acquire(lock);            // 다른 스레드의 배타적 접근을 위해서 대기
+  enum intr_level old_level = intr_disable();
+  curr->cond_signaled = false;
+  waiter_push(&cond->waiters, curr);  // cond의 대기자로 등록
+  // lock을 풀면서 더 높은 우선순위 쓰레드에게 양보될 수 있다. 그동안 signal을 받으면 cond_signaled만 켜진다
+  lock_release(lock);
+  while (!curr->cond_signaled) thread_block();  // cond_signal이 깨워줄 때까지 대기
+  intr_set_level(old_level);
+  lock_acquire(lock);  // 다른 스레드의 배타적 접근을 위해서 대기
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
@@ -370,32 +771,14 @@ void cond_signal(struct condition *cond, struct lock *lock UNUSED) {  // 조건
   ASSERT(!intr_context());
   ASSERT(lock_held_by_current_thread(lock));
 
-  if (!list_empty(&cond->waiters)) {
-    struct list_elem *max_elem = NULL;
-    int max_priority = -1;
-
-    // for문으로 가장 높은 우선순위 찾기
-    struct list_elem *e;
-    for (e = list_begin(&cond->waiters); e != list_end(&cond->waiters); e = list_next(e)) {
-      struct semaphore_elem *sema_elem = list_entry(e, struct semaphore_elem, elem);
-
-      // list_front 쓰기전에 원소가 있는지 없는지 먼저 확인할 것
-      if (list_empty(&sema_elem->semaphore.waiters)) continue;
-
-      // 대기 중인 쓰레드 중에서 가장 우선순위가 높은 쓰레드를 찾는다.
-      struct thread *waiting_thread = list_entry(list_front(&sema_elem->semaphore.waiters), struct thread, elem);
-      if (waiting_thread->priority > max_priority) {
-        max_priority = waiting_thread->priority;
-        max_elem = e;
-      }
-    }
-    if (max_elem != NULL) {  // 가장 우선순위 높은 쓰레드를 깨운다.
-      struct semaphore_elem *max_sema_elem = list_entry(max_elem, struct semaphore_elem, elem);
-      list_remove(max_elem);
-      // 해당 조건을 기다리는건 그 쓰레드 전용 semaphore를 기다리는 것으로 구현했으므로 semaphore를 풀어준다.
-      sema_up(&max_sema_elem->semaphore);
-    }
+  enum intr_level old_level = intr_disable();
+  if (!heap_empty(&cond->waiters)) {  // 가장 우선순위 높은 쓰레드를 깨운다.
+    struct thread *t = waiter_pop(&cond->waiters);
+    t->cond_signaled = true;
+    // cond_wait의 lock_release 도중 양보당해 아직 잠들지 않았다면 깨울 필요 없이 표시만 해둔다
+    if (t->status == THREAD_BLOCKED) thread_unblock(t);
   }
+  intr_set_level(old_level);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -408,5 +791,5 @@ void cond_broadcast(struct condition *cond, struct lock *lock) {
   ASSERT(cond != NULL);
   ASSERT(lock != NULL);
 
-  while (!list_empty(&cond->waiters)) cond_signal(cond, lock);
+  while (!heap_empty(&cond->waiters)) cond_signal(cond, lock);
 }
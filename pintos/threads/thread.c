@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "devices/timer.h"
 #include "filesys/file.h"
 #include "intrinsic.h"
 #include "threads/fixed-point.h"
@@ -14,6 +15,7 @@
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
 
 #ifdef USERPROG
@@ -29,15 +31,17 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-static struct list sleep_list;  // sleep_list를 관리할 이중 연결리스트 생성
-static struct list all_list;    // 모든 스레드를 관리함
-
-/* MLQFS 전용 다중 큐*/
-static struct list mlfqs_ready_queues[PRI_MAX - PRI_MIN + 1];
-static int ready_threads_count;
+/* Run queue: processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.  One
+   FIFO list per priority, and a bit in READY_MASK for each list
+   that is non-empty, so that every operation is O(1). */
+#if PRI_MAX - PRI_MIN + 1 > 64
+#error READY_MASK has one bit per priority
+#endif
+static struct list ready_queues[PRI_MAX - PRI_MIN + 1];
+static uint64_t ready_mask;
+static int ready_threads_count;  // idle을 제외한 ready 쓰레드 수
+static struct list all_list;     // 모든 스레드를 관리함
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -60,6 +64,25 @@ static long long user_ticks;   /* # of timer ticks in user programs. */
 /* mlfqs global variables */
 static fixed_t load_avg; /* 시스템 부하 평균 (fixed-point) */
 
+/* MLFQS recent_cpu decay is applied lazily.  Each second only
+   bumps MLFQS_EPOCH and records that second's decay factor; a
+   thread's recent_cpu is brought up to date, one recorded factor
+   per missed second, when it is next looked at (mlfqs_catch_up()).
+   Ready threads queued before the second ended sit on
+   MLFQS_STALE, and thread_mlfqs_refresh() brings MLFQS_BATCH of
+   them up to date per tick, requeueing only those whose priority
+   changed.  Ready threads that are up to date sit on MLFQS_FRESH.
+   Blocked threads sit on MLFQS_BLOCKED, which the same per-tick
+   pass sweeps so that none falls out of the history while it
+   sleeps. */
+#define MLFQS_HISTORY 64 /* Decay factors remembered, in seconds. */
+#define MLFQS_BATCH 8    /* Stale ready threads refreshed per tick. */
+static int64_t mlfqs_epoch;                  /* 부팅 후 지난 초 */
+static fixed_t mlfqs_decay[MLFQS_HISTORY];   /* 초 E의 감쇠 계수는 [E % MLFQS_HISTORY] */
+static struct list mlfqs_fresh;
+static struct list mlfqs_stale;
+static struct list mlfqs_blocked;
+
 /* Scheduling. */
 #define TIME_SLICE 4          /* # of timer ticks to give each thread. */
 static unsigned thread_ticks; /* # of timer ticks since last yield. */
@@ -69,6 +92,32 @@ static unsigned thread_ticks; /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If true, use the fair-share scheduler.
+   Controlled by kernel command-line option "-cfs". */
+bool thread_cfs;
+
+/* Fair-share scheduler, after Linux's CFS.  Ready threads wait in
+   CFS_TREE ordered by vruntime, their CPU time in ns scaled down by
+   their weight, and the one furthest behind runs next.  Weights
+   follow nice, each step being about 1.25x.  The running thread is
+   preempted once it has had its weighted share of the scheduling
+   period, which is CFS_LATENCY_NS, stretched so that no slice is
+   shorter than CFS_MIN_GRANULARITY_NS. */
+#define NICE_0_WEIGHT 1024
+#define CFS_LATENCY_NS 40000000LL          /* 목표 스케줄링 주기: 40 ms */
+#define CFS_MIN_GRANULARITY_NS 10000000LL  /* 최소 time slice: 10 ms (1 tick) */
+#define CFS_WAKEUP_GRANULARITY_NS 1000000LL /* 깨어난 쓰레드가 선점하려면 이만큼 뒤처져 있어야 함 */
+static struct rb_tree cfs_tree;
+static int64_t cfs_min_vruntime; /* 단조 증가하는 vruntime 기준선 */
+static int64_t cfs_load;         /* cfs_tree에 있는 쓰레드들의 weight 합 */
+
+/* Weight for each nice value from -20 to 20. */
+static const int cfs_nice_to_weight[41] = {
+    88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916, 9548, 7620, 6100, 4904,
+    3906,  3121,  2501,  1991,  1586,  1277,  1024,  820,   655,   526,   423,   335,  272,  215,
+    172,   137,   110,   87,    70,    56,    45,    36,    29,    23,    18,    15,    12,
+};
+
 /* std in/out file pointer */
 static struct file *std_in;
 static struct file *std_out;
@@ -77,11 +126,22 @@ static void kernel_thread(thread_func *, void *aux);
 
 static void idle(void *aux UNUSED);
 static struct thread *next_thread_to_run(void);
+static void ready_push(struct thread *t);
+static void ready_remove(struct thread *t);
 static void init_thread(struct thread *, const char *name, int priority);
 static void do_schedule(int status);
 static void schedule(void);
 static tid_t allocate_tid(void);
-static void thread_update_recent_cpu(struct thread *t);
+static void mlfqs_catch_up(struct thread *t);
+static void set_priority(struct thread *t, int priority);
+static int mlfqs_priority(struct thread *t);
+static int cfs_weight(const struct thread *t);
+static bool cfs_less(const struct rb_node *a, const struct rb_node *b, void *aux);
+static void cfs_charge(struct thread *t);
+static void cfs_update_min_vruntime(struct thread *running);
+static int64_t cfs_slice(struct thread *t);
+static void cfs_tick(struct thread *t);
+static bool cfs_should_preempt(struct thread *t);
 
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
@@ -121,12 +181,15 @@ void thread_init(void) {
   lgdt(&gdt_ds);
 
   /* Init the global thread context */
-  lock_init(&tid_lock);
-  lock_init(&all_list_lock);
-  list_init(&ready_list);
-  list_init(&sleep_list);
+  lock_init_named(&tid_lock, "tid");
+  lock_init_named(&all_list_lock, "all_list");
+  for (int i = PRI_MIN; i <= PRI_MAX; i++) list_init(&ready_queues[i - PRI_MIN]);
   list_init(&all_list);
   list_init(&destruction_req);
+  list_init(&mlfqs_fresh);
+  list_init(&mlfqs_stale);
+  list_init(&mlfqs_blocked);
+  rb_init(&cfs_tree, cfs_less, NULL);
 
   /* mlfqs 초기화 */
   load_avg = INT_TO_FP(0); /* load_avg 를 0.0으로 초기화 */
@@ -140,19 +203,14 @@ void thread_init(void) {
 
   /* child_info 용 필드 초기화 */
   list_init(&initial_thread->child_list);
-  lock_init(&initial_thread->children_lock);
+  lock_init_named(&initial_thread->children_lock, "children");
   initial_thread->parent_tid = 0;  //의미없음.
 
-  if (thread_mlfqs) {
+  if (thread_mlfqs)
     mlfqs_update_priority(initial_thread);  // 첫 main쓰레드 priority 설정(PRI_MAX)
-
-    // mlfqs_ready_queues에는 PRI_MIN을 시작으로 PRI_MAX까지 우선순위별 다중 큐임
-    for (int i = PRI_MIN; i <= PRI_MAX; i++) {
-      list_init(&mlfqs_ready_queues[i - PRI_MIN]);
-    }
-    ready_threads_count = 0;  // 0으로 초기화
-
-  } else
+  else if (thread_cfs)
+    printf("Fair-share scheduler enabled\n");
+  else
     printf("Priority scheduler enabled\n");
 }
 
@@ -197,9 +255,16 @@ void thread_tick(void) {
     kernel_ticks++;
 
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE) intr_yield_on_return();
+  if (thread_cfs) {
+    if (t != idle_thread) cfs_tick(t);
+  } else if (++thread_ticks >= TIME_SLICE)
+    intr_yield_on_return();
 }
 
+/* Counts N timer ticks that passed without interrupts while the
+   CPU was idle (see timer_idle_enter()). */
+void thread_account_idle(int64_t n) { idle_ticks += n; }
+
 /* Prints thread statistics. */
 void thread_print_stats(void) {
   printf("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n", idle_ticks, kernel_ticks, user_ticks);
@@ -233,11 +298,12 @@ tid_t thread_create(const char *name, int priority, thread_func *function, void
   /* Initialize thread. */
   init_thread(t, name, priority);
   tid = t->tid = allocate_tid();
+  trace_create(t);
 
   struct thread *curr = thread_current();
   /* child_info 용 필드 초기화 (userprog에서 추가)*/
   list_init(&t->child_list);
-  lock_init(&t->children_lock);
+  lock_init_named(&t->children_lock, "children");
   t->parent_tid = curr->tid;
 
   /* child_info 만들어서 부모에게 붙이기 (userprog에서 추가)*/
@@ -307,7 +373,13 @@ tid_t thread_create(const char *name, int priority, thread_func *function, void
 void thread_block(void) {
   ASSERT(!intr_context());
   ASSERT(intr_get_level() == INTR_OFF);
-  thread_current()->status = THREAD_BLOCKED;
+  struct thread *curr = thread_current();
+  if (thread_mlfqs && curr != idle_thread) {  // 자는 동안에도 감쇠를 따라잡도록
+    // mlfqs_blocked는 뒤쪽일수록 최신이어야 sweep이 맨 앞에서 멈출 수 있다. 넣기 전에 최신으로 맞춘다
+    mlfqs_catch_up(curr);
+    list_push_back(&mlfqs_blocked, &curr->mlfqs_elem);
+  }
+  curr->status = THREAD_BLOCKED;
   schedule();
 }
 
@@ -327,18 +399,19 @@ void thread_unblock(struct thread *t) {
   old_level = intr_disable();           // 인터럽트를 disable상태로 만들고 이전 상태를
                                         // 반환(기존 상태 저장해놓고, disable 만듬)
   ASSERT(t->status == THREAD_BLOCKED);  // 해당 쓰레드의 status 필드가 THREAD_BLOCKED인지 확인
+  trace_wakeup(t);
 
-  if (thread_mlfqs) {
-    list_push_back(&mlfqs_ready_queues[t->priority - PRI_MIN], &t->elem);  // 우선순위에 맞는 큐에 집어넣음
-    if (t != idle_thread)  // idle thread는 카운트 하면 안되므로
-      ready_threads_count++;
-  } else {
-    list_insert_ordered(&ready_list, &t->elem, thread_priority_less, NULL);  // 우선순위 큰 순서대로 삽입
+  if (thread_cfs) {  // 오래 잔 쓰레드가 그동안 못 쓴 시간을 한꺼번에 몰아 쓰지 않도록
+    int64_t floor = cfs_min_vruntime - CFS_LATENCY_NS / 2;
+    if (t->vruntime < floor) t->vruntime = floor;
   }
+  // 막 생성된 쓰레드는 thread_block()을 거치지 않아 mlfqs_elem이 아직 0이다
+  if (thread_mlfqs && t->mlfqs_elem.next != NULL) list_remove(&t->mlfqs_elem);
+  ready_push(t);              // 우선순위에 맞는 큐에 집어넣음
   t->status = THREAD_READY;  // 해당 쓰레드의 상태를 THREAD_READY로 바꿈
 
   // 인터럽트끝나고 보내야할 경우에
-  if (t->priority > thread_current()->priority) {
+  if (thread_cfs ? cfs_should_preempt(t) : t->priority > thread_current()->priority) {
     if (intr_context()) {
       // 인터럽트 핸들러 내부: 나중에 yield
       intr_yield_on_return();
@@ -403,28 +476,12 @@ void thread_yield(void) {  // 현재 스레드가 가장 높은 우선순위를
 
   enum intr_level old_level = intr_disable();
   if (curr != idle_thread) {
-    if (thread_mlfqs) {  // mlfqs 모드인 경우
-      int max_priority = max_priority_mlfqs_queue();
-      if (max_priority >= 0) {  // 전체 큐가 비어있지 않은 경우
-        if (curr->priority > max_priority) {
-          intr_set_level(old_level);
-          return;
-        }
-      }
-      list_push_back(&mlfqs_ready_queues[curr->priority - PRI_MIN],
-                     &curr->elem);  // 본인 우선순위에 맞는 레디큐로 들어감
-      ready_threads_count++;
-    } else {
-      if (!list_empty(&ready_list)) {
-        struct thread *highest = list_entry(list_front(&ready_list), struct thread, elem);
-
-        if (curr->priority > highest->priority) {  // 현재 쓰레드가 ready_list에 있는 쓰레드들보다 우선순위가 높다면
-          intr_set_level(old_level);
-          return;  // yield를 할 필요가 없음.
-        }
-      }
-      list_insert_ordered(&ready_list, &curr->elem, thread_priority_less, NULL);  // 우선순위 순으로 정렬하며 삽입
+    int max_priority = max_ready_priority();
+    if (!thread_cfs && max_priority >= 0 && curr->priority > max_priority) {  // 현재 쓰레드가 ready 쓰레드들보다 우선순위가 높다면
+      intr_set_level(old_level);
+      return;  // yield를 할 필요가 없음.
     }
+    ready_push(curr);  // 본인 우선순위에 맞는 레디큐로 들어감
   }
   do_schedule(THREAD_READY);
   intr_set_level(old_level);
@@ -444,47 +501,153 @@ void thread_set_priority(int new_priority) {
     thread_yield();                   // yield를 통해 뒤로 보냄
   }
 }
-// thread_update_all_priority 생성해야함
-void thread_update_all_priority(void) {
-  enum intr_level old_level = intr_disable();  // 인터럽트 끄기
-  struct list_elem *e;                         // all_list 순회 시 사용하는 iterator
-  struct list new_ready_queue;                 // ready 큐 임시 저장(싹다 뺐다가 싹다 넣을 거임)
-  list_init(&new_ready_queue);                 // new_ready 큐 초기화
-
-  /* all list 순회하며 priority 갱신 */
-  for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e)) {
-    struct thread *t = list_entry(e, struct thread, all_elem);
-    if (t == idle_thread) continue;                // idle 쓰레드는 제외
-    if (t->status == THREAD_READY) {               // ready queue에 있던 thread라면
-      list_remove(&t->elem);                       // 기존에 있던 ready queue에서 빼고
-      list_push_back(&new_ready_queue, &t->elem);  //임시 저장 큐에 집어넣기
-    }
-    mlfqs_update_priority(t);  // priority 조정
+/* Called from the timer interrupt every tick under MLFQS.
+   Refreshes up to MLFQS_BATCH ready threads whose recent_cpu
+   predates the last second boundary, and brings up to
+   MLFQS_BATCH blocked threads up to date. */
+void thread_mlfqs_refresh(void) {
+  ASSERT(intr_context());
+
+  for (int i = 0; i < MLFQS_BATCH && !list_empty(&mlfqs_stale); i++) {
+    struct thread *t = list_entry(list_pop_front(&mlfqs_stale), struct thread, mlfqs_elem);
+    list_push_back(&mlfqs_fresh, &t->mlfqs_elem);
+    mlfqs_catch_up(t);
+
+    int new_priority = mlfqs_priority(t);
+    if (new_priority != t->priority) thread_requeue(t, new_priority);  // 우선순위가 바뀐 쓰레드만 큐를 옮긴다
   }
 
-  // ready 큐들은 다시 다중 큐에 집어 넣기
-  while (!list_empty(&new_ready_queue)) {
-    e = list_pop_front(&new_ready_queue);
-    struct thread *t = list_entry(e, struct thread, elem);
-    list_push_back(&mlfqs_ready_queues[t->priority - PRI_MIN], e);
+  // blocked 쓰레드는 recent_cpu만 따라잡는다. 우선순위는 깨어날 때 ready_push()가 계산
+  // thread_block()과 이 루프 모두 최신으로 맞춘 뒤에만 뒤에 넣으므로, 맨 앞이 최신이면 나머지도 모두 최신이다
+  for (int i = 0; i < MLFQS_BATCH && !list_empty(&mlfqs_blocked); i++) {
+    struct thread *t = list_entry(list_front(&mlfqs_blocked), struct thread, mlfqs_elem);
+    if (t->mlfqs_epoch == mlfqs_epoch) break;
+    list_pop_front(&mlfqs_blocked);
+    mlfqs_catch_up(t);
+    list_push_back(&mlfqs_blocked, &t->mlfqs_elem);
   }
 
-  // 혹시 현재 스레드의 우선순위가 레디큐에 있는 쓰레드보다 작거나 같다면 양보해야함
-  if (thread_current()->priority < max_priority_mlfqs_queue()) {
-    if (intr_context()) {
-      intr_yield_on_return();
-    } else {
-      intr_set_level(old_level);  // 인터럽트 풀어주고
-      thread_yield();             // 양보
-      return;
-    }
+  // 혹시 현재 스레드의 우선순위가 레디큐에 있는 쓰레드보다 작다면 양보해야함
+  if (thread_current()->priority < max_ready_priority()) intr_yield_on_return();
+}
+
+/* Called from the timer interrupt once a second under MLFQS,
+   after load_avg is updated.  Starts a new epoch: every thread but
+   the running one now has a stale recent_cpu. */
+void thread_mlfqs_new_second(void) {
+  mlfqs_epoch++;
+  mlfqs_decay[mlfqs_epoch % MLFQS_HISTORY] = DIV_FP(MULT_FP_INT(load_avg, 2), ADD_FP_INT(MULT_FP_INT(load_avg, 2), 1));
+
+  // 지금까지 최신이던 ready 쓰레드들을 통째로 stale로 넘긴다
+  if (!list_empty(&mlfqs_fresh)) list_splice(list_end(&mlfqs_stale), list_begin(&mlfqs_fresh), list_end(&mlfqs_fresh));
+
+  struct thread *curr = thread_current();
+  if (curr != idle_thread) {
+    mlfqs_catch_up(curr);
+    mlfqs_update_priority(curr);
   }
+}
 
-  intr_set_level(old_level);  // 인터럽트 복원
+/* Applies to T's recent_cpu the decay of each second since it was
+   last brought up to date:
+     recent_cpu = load_avg * 2 / (load_avg * 2 + 1) * recent_cpu + nice
+   Seconds older than the history are skipped, which leaves
+   recent_cpu too high (at load_avg 60, 64 seconds decay it only to
+   about 0.59 of its value).  thread_mlfqs_refresh() sweeps
+   MLFQS_BATCH * TIMER_FREQ blocked threads a second, so that only
+   happens with more than MLFQS_HISTORY times that many blocked. */
+static void mlfqs_catch_up(struct thread *t) {
+  if (t->mlfqs_epoch < mlfqs_epoch - MLFQS_HISTORY) t->mlfqs_epoch = mlfqs_epoch - MLFQS_HISTORY;
+
+  while (t->mlfqs_epoch < mlfqs_epoch) {
+    int64_t e = ++t->mlfqs_epoch;
+    t->recent_cpu = ADD_FP_INT(MULT_FP(mlfqs_decay[e % MLFQS_HISTORY], t->recent_cpu), t->nice);
+  }
 }
+
 void mlfqs_update_priority(struct thread *t) {
   if (!thread_mlfqs) return;  // mlqfs 가 아니라면 나가라
 
+  set_priority(t, mlfqs_priority(t));
+}
+
+/* Returns T's CFS weight. */
+static int cfs_weight(const struct thread *t) { return cfs_nice_to_weight[t->nice + 20]; }
+
+static bool cfs_less(const struct rb_node *a, const struct rb_node *b, void *aux UNUSED) {
+  return rb_entry(a, struct thread, cfs_node)->vruntime < rb_entry(b, struct thread, cfs_node)->vruntime;
+}
+
+/* Charges T, which is or just was running, for the CPU time it
+   has used since it was last charged. */
+static void cfs_charge(struct thread *t) {
+  int64_t now = timer_ns();
+  int64_t delta = now - t->exec_start;
+  if (delta <= 0) return;
+
+  t->exec_start = now;
+  t->sum_exec += delta;
+  t->vruntime += delta * NICE_0_WEIGHT / cfs_weight(t);
+}
+
+/* Advances cfs_min_vruntime to the smallest vruntime among the
+   ready threads and RUNNING, if RUNNING is not the idle thread.
+   It never goes backward. */
+static void cfs_update_min_vruntime(struct thread *running) {
+  bool found = false;
+  int64_t min = 0;
+
+  if (running != idle_thread) {
+    min = running->vruntime;
+    found = true;
+  }
+  if (!rb_empty(&cfs_tree)) {
+    int64_t leftmost = rb_entry(rb_first(&cfs_tree), struct thread, cfs_node)->vruntime;
+    if (!found || leftmost < min) min = leftmost;
+    found = true;
+  }
+  if (found && min > cfs_min_vruntime) cfs_min_vruntime = min;
+}
+
+/* Returns the time slice running thread T is due: its weighted
+   share of the scheduling period. */
+static int64_t cfs_slice(struct thread *t) {
+  int64_t nr_running = ready_threads_count + 1;
+  int64_t period = CFS_LATENCY_NS;
+  if (nr_running * CFS_MIN_GRANULARITY_NS > period) period = nr_running * CFS_MIN_GRANULARITY_NS;
+
+  int64_t slice = period * cfs_weight(t) / (cfs_load + cfs_weight(t));
+  return slice < CFS_MIN_GRANULARITY_NS ? CFS_MIN_GRANULARITY_NS : slice;
+}
+
+/* Called every tick for the running thread T under CFS.  Asks for
+   a reschedule when T has used up its slice, or has got more than
+   a slice ahead of the thread furthest behind. */
+static void cfs_tick(struct thread *t) {
+  cfs_charge(t);
+  cfs_update_min_vruntime(t);
+  if (rb_empty(&cfs_tree)) return;
+
+  /* tick 단위로만 확인할 수 있으므로 반 tick 이내의 차이는 다 쓴 것으로 본다. */
+  int64_t ran = t->sum_exec - t->slice_start + CFS_MIN_GRANULARITY_NS / 2;
+  int64_t slice = cfs_slice(t);
+  struct thread *leftmost = rb_entry(rb_first(&cfs_tree), struct thread, cfs_node);
+  if (ran >= slice || (ran >= CFS_MIN_GRANULARITY_NS && t->vruntime - leftmost->vruntime > slice))
+    intr_yield_on_return();
+}
+
+/* Returns true if T, just made ready, should preempt the running
+   thread: it is behind by more than the wakeup granularity. */
+static bool cfs_should_preempt(struct thread *t) {
+  struct thread *curr = thread_current();
+  if (curr == idle_thread) return true;
+
+  cfs_charge(curr);
+  return t->vruntime + CFS_WAKEUP_GRANULARITY_NS < curr->vruntime;
+}
+
+/* Returns the MLFQS priority T's recent_cpu and nice give it. */
+static int mlfqs_priority(struct thread *t) {
   ASSERT(t != NULL);
 
   /* recent CPU /4 */
@@ -500,7 +663,7 @@ void mlfqs_update_priority(struct thread *t) {
   if (new_priority > PRI_MAX) new_priority = PRI_MAX;  // max를 넘어갔으면 max로
   if (new_priority < PRI_MIN) new_priority = PRI_MIN;  // min을 넘어갔으면 min으로
 
-  t->priority = new_priority;
+  return new_priority;
 }
 
 /* Returns the current thread's priority. */
@@ -517,13 +680,14 @@ void thread_set_nice(int nice) {
   enum intr_level old_level = intr_disable();
   //현재 스레드의 nice 값 업데이트
   struct thread *curr = thread_current();
+  if (thread_cfs) cfs_charge(curr);  // 지금까지 쓴 시간은 이전 weight로 정산
   curr->nice = nice;
   // 자신의 priority 재계산
   mlfqs_update_priority(curr);
 
   // 만약 자신이 더 이상 최고 priority가 아니면 양보
   /* 조건보고 양보하는 경우 (다른 쓰레드에 의해서 race 발생해서 max가 바뀔수도 있음)*/
-  if (curr->priority < max_priority_mlfqs_queue()) {
+  if (curr->priority < max_ready_priority()) {
     if (intr_context()) {
       intr_yield_on_return();
     } else {
@@ -550,21 +714,6 @@ void thread_update_load_avg(void) {
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int thread_get_recent_cpu(void) { return FP_TO_INT_ZERO(MULT_FP_INT(thread_current()->recent_cpu, 100)); }
-void thread_update_all_recent_cpu(void) {
-  struct list_elem *e;  // thread_list 순회 시 사용하는 iterator
-
-  /* all list 순회하며 recent_cpu 갱신 */
-  for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e)) {
-    struct thread *t = list_entry(e, struct thread, all_elem);
-    if (t != idle_thread) thread_update_recent_cpu(t);
-  }
-}
-// 각 리스트 별로 매크로 떡칠인 라인을 넣자니 너무 지저분해서 따로 함수로 만듬
-/* recent_cpu = load_avg * 2 / (load_avg * 2 + 1) * recent_cpu  + nice */
-static void thread_update_recent_cpu(struct thread *t) {
-  t->recent_cpu = ADD_FP_INT(
-      MULT_FP(DIV_FP(MULT_FP_INT(load_avg, 2), ADD_FP_INT(MULT_FP_INT(load_avg, 2), 1)), t->recent_cpu), t->nice);
-}
 
 /* Idle thread.  Executes when no other thread is ready to run.
 
@@ -586,6 +735,10 @@ static void idle(void *idle_started_ UNUSED) {
     intr_disable();
     thread_block();
 
+    /* Nothing else to run: stop the periodic tick until the next
+       sleeper is due. */
+    timer_idle_enter();
+
     /* Re-enable interrupts and wait for the next one.
 
        The `sti' instruction disables interrupts until the
@@ -624,7 +777,6 @@ static void init_thread(struct thread *t, const char *name, int priority) {
   t->tf.rsp = (uint64_t)t + PGSIZE - sizeof(void *);
   t->magic = THREAD_MAGIC;
 
-  t->wake_tick = 0;  // 깨워야하는 시간 초기화
 
   t->priority = priority;
   t->original_priority = priority;
@@ -635,6 +787,9 @@ static void init_thread(struct thread *t, const char *name, int priority) {
   /* mlfqs 멤버 초기화 */
   t->nice = 0;
   t->recent_cpu = INT_TO_FP(0);
+  t->mlfqs_epoch = mlfqs_epoch;
+  t->vruntime = cfs_min_vruntime;  // 새 쓰레드는 지금 가장 뒤처진 쓰레드와 같은 출발선에서
+  t->sum_exec = 0;
 
 #ifdef VM
   list_init(&t->mmap_list);
@@ -647,21 +802,64 @@ static void init_thread(struct thread *t, const char *name, int priority) {
    will be in the run queue.)  If the run queue is empty, return
    idle_thread. */
 static struct thread *next_thread_to_run(void) {
-  if (thread_mlfqs) {  // mlfqs 일 때
-    int max_priority;
-    if ((max_priority = max_priority_mlfqs_queue()) >= 0) {  // ready 다중 큐에서 존재하는 가장 높은 prioirty 반환
-      ready_threads_count--;                                 // ready_thread_count를 뺌
-      struct thread *selected =
-          list_entry(list_pop_front(&mlfqs_ready_queues[max_priority - PRI_MIN]), struct thread, elem);
-      return selected;
-    } else  // 큐에 존재하는 쓰레드가 없을 때
-      return idle_thread;
-  } else {  // 일반적인 경우 일 때
-    if (list_empty(&ready_list))
-      return idle_thread;
-    else
-      return list_entry(list_pop_front(&ready_list), struct thread, elem);
+  if (thread_cfs) {
+    if (rb_empty(&cfs_tree)) return idle_thread;
+    struct thread *leftmost = rb_entry(rb_first(&cfs_tree), struct thread, cfs_node);
+    ready_remove(leftmost);
+    return leftmost;
+  }
+
+  int max_priority = max_ready_priority();  // ready 다중 큐에서 존재하는 가장 높은 prioirty
+  if (max_priority < 0)                     // 큐에 존재하는 쓰레드가 없을 때
+    return idle_thread;
+
+  struct thread *selected = list_entry(list_front(&ready_queues[max_priority - PRI_MIN]), struct thread, elem);
+  ready_remove(selected);
+  if (thread_mlfqs) mlfqs_catch_up(selected);  // 실행 중인 쓰레드의 recent_cpu는 항상 최신이어야 한다
+  return selected;
+}
+
+/* Appends T to the run queue for its priority. */
+static void ready_push(struct thread *t) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (thread_cfs) {
+    if (t == running_thread()) cfs_charge(t);  // yield하는 쓰레드는 지금까지 쓴 시간부터 반영
+    rb_insert(&cfs_tree, &t->cfs_node);
+    cfs_load += cfs_weight(t);
+    if (t != idle_thread) ready_threads_count++;
+    return;
+  }
+
+  if (thread_mlfqs && t != idle_thread) {  // 막 깨어난 쓰레드는 밀린 감쇠부터 반영
+    mlfqs_catch_up(t);
+    set_priority(t, mlfqs_priority(t));  // cond_wait 도중 선점된 쓰레드는 아직 waiter heap 안에 있다
+    list_push_back(&mlfqs_fresh, &t->mlfqs_elem);
   }
+  ASSERT(t->priority >= PRI_MIN && t->priority <= PRI_MAX);
+
+  list_push_back(&ready_queues[t->priority - PRI_MIN], &t->elem);
+  ready_mask |= 1ULL << (t->priority - PRI_MIN);
+  if (t != idle_thread)  // idle thread는 카운트 하면 안되므로
+    ready_threads_count++;
+}
+
+/* Removes T from the run queue.  T's priority must not have
+   changed since it was queued. */
+static void ready_remove(struct thread *t) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (thread_cfs) {
+    rb_remove(&cfs_tree, &t->cfs_node);
+    cfs_load -= cfs_weight(t);
+    if (t != idle_thread) ready_threads_count--;
+    return;
+  }
+
+  list_remove(&t->elem);
+  if (list_empty(&ready_queues[t->priority - PRI_MIN])) ready_mask &= ~(1ULL << (t->priority - PRI_MIN));
+  if (t != idle_thread) ready_threads_count--;
+  if (thread_mlfqs && t != idle_thread) list_remove(&t->mlfqs_elem);
 }
 
 /* Use iretq to launch the thread */
@@ -794,12 +992,24 @@ static void schedule(void) {
   /* Start new time slice. */
   thread_ticks = 0;  // 쓰레드가 yield 한 이후로 지난 시간, 0으로 세팅
 
+  /* idle에서 벗어날 때 멈춰 있던 tick 수를 바로잡는다. */
+  if (curr == idle_thread && next != idle_thread) timer_idle_exit();
+
+  if (thread_cfs) {  // 나가는 쓰레드의 실행 시간을 정산하고 들어오는 쓰레드의 slice를 시작
+    if (curr != idle_thread) cfs_charge(curr);
+    next->exec_start = timer_ns();
+    next->slice_start = next->sum_exec;
+    cfs_update_min_vruntime(next);
+  }
+
 #ifdef USERPROG
   /* Activate the new address space. */
   process_activate(next);
 #endif
 
   if (curr != next) {
+    trace_switch(curr, next);
+
     /* If the thread we switched from is dying, destroy its struct
        thread. This must happen late so that thread_exit() doesn't
        pull out the rug under itself.
@@ -834,27 +1044,38 @@ static tid_t allocate_tid(void) {
   return tid;
 }
 
-struct list *get_ready_list(void) {
-  return &ready_list;
-}
-struct list *get_sleep_list(void) {
-  return &sleep_list;
+/* Returns the highest priority among ready threads, or -1 if
+   there are none. */
+int max_ready_priority(void) {
+  if (ready_mask == 0) return -1;  //아예 비어있다면
+  return PRI_MIN + 63 - __builtin_clzll(ready_mask);  // bsr: 가장 높은 비트
 }
 
-bool thread_priority_less(const struct list_elem *a, const struct list_elem *b, void *aux) {
-  struct thread *thread_a = list_entry(a, struct thread, elem);
-  struct thread *thread_b = list_entry(b, struct thread, elem);
+/* Sets the priority of T to PRIORITY, moving it to the matching
+   run queue if it is ready and to its new place among the waiters
+   of whatever it is waiting on. */
+void thread_requeue(struct thread *t, int priority) {
+  ASSERT(intr_get_level() == INTR_OFF);
 
-  return thread_a->priority > thread_b->priority;
+  if (t->status != THREAD_READY) {
+    set_priority(t, priority);
+  } else {
+    ready_remove(t);
+    set_priority(t, priority);
+    ready_push(t);
+  }
 }
 
-int max_priority_mlfqs_queue(void) {  // mlfqs에서 존재하는 ready_thread 중 가장 높은 우선순위를 반환
-  for (int i = PRI_MAX; i >= PRI_MIN; i--) {  // 우선순위 다중 ready 큐 순회, 우선순위 높은 순으로
-    if (!list_empty(&mlfqs_ready_queues[i - PRI_MIN])) {  //노드가 있는 큐를 찾았으면
-      return i;
-    }
-  }
-  return -1;  //아예 비어있다면
+/* Sets T's priority to PRIORITY, moving T within the semaphore or
+   condition variable waiter heap it is in, if any.  Every change
+   to the priority of a thread that may be waiting goes through
+   here, so that the heap stays ordered.  Leaves the run queue
+   alone. */
+static void set_priority(struct thread *t, int priority) {
+  int old_priority = t->priority;
+
+  t->priority = priority;
+  if (t->wait_queue != NULL && priority != old_priority) synch_priority_changed(t, old_priority);  // 대기 heap 안에서도 자리를 옮긴다
 }
 
 bool is_not_idle(struct thread *t) { return t != idle_thread; }
@@ -874,6 +1095,17 @@ struct thread *thread_get_by_tid(tid_t tid) {
   lock_release(&all_list_lock);
   return NULL;
 }
+
+/* Invokes FUNC on every thread, passing along AUX.  FUNC runs with
+   all_list_lock held, so it must not create or exit threads. */
+void thread_foreach(thread_action_func *func, void *aux) {
+  struct list_elem *e;
+
+  lock_acquire(&all_list_lock);
+  for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e))
+    func(list_entry(e, struct thread, all_elem), aux);
+  lock_release(&all_list_lock);
+}
 /* userprog에서 추가*/
 struct file *init_std() {
   struct file *new_file = (struct file *)malloc(sizeof(struct file));
@@ -0,0 +1,186 @@
+#include "threads/trace.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "devices/timer.h"
+#include "intrinsic.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* A ring of fixed-size binary scheduler events, stamped with the
+   TSC so that recording one costs little more than a few stores.
+   Only the most recent TRACE_EVENTS events are kept.  At power off
+   they are printed one per line, with times in nanoseconds, for
+   utils/sched-trace to turn into a Chrome trace-viewer file. */
+
+#define TRACE_PAGES 64 /* Size of the ring, in pages. */
+
+enum trace_type {
+  TRACE_CREATE,        /* TID created, or found by trace_init(), named NAME. */
+  TRACE_SWITCH,        /* TID switched out for OTHER; REASON is TID's new status. */
+  TRACE_WAKEUP,        /* TID unblocked by OTHER, or by an interrupt if REASON. */
+  TRACE_PREEMPT,       /* Interrupt asked TID to yield on return. */
+  TRACE_DONATE,        /* OTHER donated priority PRIO to TID. */
+  TRACE_LOCK_WAIT,     /* TID blocked on lock OBJ, held by OTHER. */
+  TRACE_LOCK_ACQUIRED, /* TID acquired lock OBJ after waiting. */
+};
+
+static const char *type_names[] = {"create", "switch", "wakeup", "preempt", "donate", "lock-wait", "lock-acquired"};
+
+struct trace_event {
+  uint64_t tsc;    /* When, in TSC cycles. */
+  uint8_t type;    /* enum trace_type. */
+  uint8_t reason;  /* Depends on TYPE. */
+  uint8_t prio;    /* TID's priority, or the donated one. */
+  uint8_t pad;
+  int32_t tid;     /* Thread the event is about. */
+  union {
+    struct {
+      int32_t other; /* The other thread involved, or 0. */
+      uint32_t pad2;
+      uint64_t obj;  /* Lock involved, or 0. */
+    };
+    char name[16];   /* TRACE_CREATE: thread name. */
+  };
+};
+
+#define TRACE_EVENTS (TRACE_PAGES * PGSIZE / sizeof(struct trace_event))
+
+/* Set by "-trace". */
+bool trace_enabled;
+
+static struct trace_event *events;  // TRACE_EVENTS개짜리 ring
+static bool recording;              // ring이 준비되었고 출력 중이 아닐 때만 기록
+static uint64_t event_cnt;          // 지금까지 기록한 이벤트 수
+
+/* thread_foreach() callback for trace_init(). */
+static void name_thread(struct thread *t, void *aux UNUSED) { trace_create(t); }
+
+/* Allocates the event ring, if tracing was enabled on the command
+   line, and names the threads that already exist. */
+void trace_init(void) {
+  if (!trace_enabled) return;
+
+  events = palloc_get_multiple(0, TRACE_PAGES);
+  if (events == NULL) {
+    printf("Tracing disabled: no memory for events.\n");
+    trace_enabled = false;
+    return;
+  }
+  recording = true;
+  thread_foreach(name_thread, NULL);
+  printf("Tracing scheduler events.\n");
+}
+
+/* Claims the next slot in the ring and fills in the fields every
+   event has.  Interrupts must be off. */
+static struct trace_event *trace_add(enum trace_type type, const struct thread *t) {
+  struct trace_event *e = &events[event_cnt++ % TRACE_EVENTS];
+
+  e->tsc = rdtsc();
+  e->type = type;
+  e->reason = 0;
+  e->prio = t->priority;
+  e->tid = t->tid;
+  e->other = 0;
+  e->obj = 0;
+  return e;
+}
+
+/* Records T's name, when T is created. */
+void trace_create(const struct thread *t) {
+  if (!recording) return;
+
+  enum intr_level old_level = intr_disable();
+  struct trace_event *e = trace_add(TRACE_CREATE, t);
+  strlcpy(e->name, t->name, sizeof e->name);
+  intr_set_level(old_level);
+}
+
+/* Records a context switch from PREV to NEXT.  PREV's status says
+   why: ready if it yielded or was preempted, blocked, or dying.
+   Interrupts must be off. */
+void trace_switch(const struct thread *prev, const struct thread *next) {
+  if (!recording) return;
+
+  struct trace_event *e = trace_add(TRACE_SWITCH, prev);
+  e->reason = prev->status;
+  e->other = next->tid;
+}
+
+/* Records that T is being unblocked by the running thread, or by
+   an interrupt handler.  Interrupts must be off. */
+void trace_wakeup(const struct thread *t) {
+  if (!recording) return;
+
+  struct trace_event *e = trace_add(TRACE_WAKEUP, t);
+  e->reason = intr_context();
+  e->other = intr_context() ? 0 : thread_current()->tid;
+}
+
+/* Records that an interrupt handler asked the running thread to
+   yield when the interrupt returns. */
+void trace_preempt(void) {
+  if (!recording) return;
+
+  trace_add(TRACE_PREEMPT, thread_current());
+}
+
+/* Records that the running thread is donating PRIORITY to
+   RECIPIENT.  Interrupts must be off. */
+void trace_donate(const struct thread *recipient, int priority) {
+  if (!recording) return;
+
+  struct trace_event *e = trace_add(TRACE_DONATE, recipient);
+  e->prio = priority;
+  e->other = thread_current()->tid;
+}
+
+/* Records that the running thread is about to block on LOCK.
+   Interrupts must be off. */
+void trace_lock_wait(const struct lock *lock) {
+  if (!recording) return;
+
+  struct trace_event *e = trace_add(TRACE_LOCK_WAIT, thread_current());
+  e->other = lock->holder != NULL ? lock->holder->tid : 0;
+  e->obj = (uintptr_t)lock;
+}
+
+/* Records that the running thread got LOCK after waiting for it.
+   Interrupts must be off. */
+void trace_lock_acquired(const struct lock *lock) {
+  if (!recording) return;
+
+  struct trace_event *e = trace_add(TRACE_LOCK_ACQUIRED, thread_current());
+  e->obj = (uintptr_t)lock;
+}
+
+/* Prints the events still in the ring, oldest first, one per
+   line:
+     Trace: NS TYPE TID OTHER REASON PRIO OBJ
+   or, for thread creation,
+     Trace: NS create TID NAME */
+void trace_print_stats(void) {
+  if (events == NULL) return;
+
+  recording = false;  // 출력하는 동안 ring이 바뀌지 않도록 기록을 멈춘다
+  barrier();
+  uint64_t kept = event_cnt < TRACE_EVENTS ? event_cnt : TRACE_EVENTS;
+  printf("Trace: %" PRIu64 " events, %" PRIu64 " kept\n", event_cnt, kept);
+  for (uint64_t i = event_cnt - kept; i < event_cnt; i++) {
+    const struct trace_event *e = &events[i % TRACE_EVENTS];
+    int64_t ns = timer_tsc_to_ns(e->tsc);
+
+    if (e->type == TRACE_CREATE)
+      printf("Trace: %" PRId64 " create %d %s\n", ns, e->tid, e->name);
+    else
+      printf("Trace: %" PRId64 " %s %d %d %d %d %#" PRIx64 "\n", ns, type_names[e->type], e->tid, e->other,
+             e->reason, e->prio, e->obj);
+  }
+}
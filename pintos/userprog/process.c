@@ -497,9 +497,7 @@ static bool load(const char **argv, struct intr_frame *if_) {
   process_activate(thread_current());
 
   /* Open executable file. */
-  lock_acquire(&filesys_lock);
   file = filesys_open(file_name);
-  lock_release(&filesys_lock);
   if (file == NULL) {
     printf("load: %s: open failed\n", file_name);
     goto done;
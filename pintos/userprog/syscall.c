@@ -1,14 +1,20 @@
 #include "userprog/syscall.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include <time.h>
 
+#include "devices/disk.h"
+#include "devices/input.h"
+#include "devices/timer.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "intrinsic.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/loader.h"
+#include "threads/malloc.h"
 #include "threads/thread.h"
 #include "userprog/gdt.h"
 #include "userprog/process.h"
@@ -32,8 +38,12 @@ static unsigned system_tell(int fd);
 static int system_dup2(int oldfd, int newfd);
 static void *system_mmap(void *addr, size_t length, int writable, int fd, off_t offset);
 static void system_munmap(void *addr);
+static bool system_diskstat(int chan_no, int dev_no, struct diskstat *stats);
+static int system_clock_gettime(clockid_t clock, struct timespec *ts);
+static int system_lockstat(struct lockstat *stats, int max);
 
 static void validate_user_string(const char *str);
+static void validate_user_buffer(const void *buf, size_t size, bool writable);
 static int expend_fd_table(struct thread *curr, size_t size);
 
 /* System call.
@@ -49,13 +59,10 @@ static int expend_fd_table(struct thread *curr, size_t size);
 #define MSR_LSTAR 0xc0000082        /* Long mode SYSCALL target */
 #define MSR_SYSCALL_MASK 0xc0000084 /* Mask for the eflags */
 
-struct lock filesys_lock; /* filesys 함수 접근 시 동기화 용 */
-
 void syscall_init(void) {
   write_msr(MSR_STAR, ((uint64_t)SEL_UCSEG - 0x10) << 48 | ((uint64_t)SEL_KCSEG) << 32);
   write_msr(MSR_LSTAR, (uint64_t)syscall_entry);
 
-  lock_init(&filesys_lock);
   /* The interrupt service rountine should not serve any interrupts
    * until the syscall_entry swaps the userland stack to the kernel
    * mode stack. Therefore, we masked the FLAG_FL. */
@@ -125,6 +132,15 @@ void syscall_handler(struct intr_frame *f UNUSED) {
     case SYS_MUNMAP:
       system_munmap(f->R.rdi);
       break;
+    case SYS_DISKSTAT:
+      f->R.rax = system_diskstat(f->R.rdi, f->R.rsi, f->R.rdx);
+      break;
+    case SYS_CLOCK_GETTIME:
+      f->R.rax = system_clock_gettime(f->R.rdi, f->R.rsi);
+      break;
+    case SYS_LOCKSTAT:
+      f->R.rax = system_lockstat(f->R.rdi, f->R.rsi);
+      break;
     default:
       printf("unknown! %d\n", f->R.rax);
       thread_exit();
@@ -168,24 +184,17 @@ static int system_exec(const char *cmdd_line) {
 static int system_wait(pid_t pid) { return process_wait(pid); }
 static bool system_create(const char *file, unsigned initial_size) {
   validate_user_string(file);  // file이 널 문자인지, 혹은 페이지 테이블에 없는 주소인지
-  // 대신에 락이 걸려야함
-  lock_acquire(&filesys_lock);                       // 동시접근을 막기 위해
   bool result = filesys_create(file, initial_size);  // 파일 생성
-  lock_release(&filesys_lock);
   return result;  // 파일 생성이 성공적이면 true, 아니면 false
 }
 static bool system_remove(const char *file) {
   validate_user_string(file);          // file이 널 문자인지, 혹은 페이지 테이블에 없는 주소인지
-  lock_acquire(&filesys_lock);         // 동시접근을 막기 위해
   bool result = filesys_remove(file);  // 파일 삭제
-  lock_release(&filesys_lock);
   return result;  // 파일 삭제가 성공적이면 true, 아니면 false
 }
 static int system_open(const char *file) {
   validate_user_string(file);   // file 이 널문자인지, 혹은 페이지 테이블에 없는 주소인지
-  lock_acquire(&filesys_lock);  // 동시접근을 막기 위해
   struct file *open_file = filesys_open(file);  // 파일 열기
-  lock_release(&filesys_lock);
   if (!open_file) return -1;  //파일 열기 실패 시 종료
 
   // fd 할당
@@ -203,9 +212,7 @@ static int system_open(const char *file) {
   if (new_fd == -1) {  // 확장이 필요하다면
     if (expend_fd_table(curr, 1) < 0) {
       // 확장 실패 했다면
-      lock_acquire(&filesys_lock);
       file_close(open_file);  //파일 닫고
-      lock_release(&filesys_lock);
       return -1;  //-1 리턴하고 종료
     }
     new_fd = curr->fd_max + 1;  //확장 후 new_fd 설정
@@ -222,31 +229,23 @@ static int system_filesize(int fd) {
     return -1;                                                                    // -1 리턴하고 종료
   int file_size = -1;        //해당 fd에 파일이 없을때 -1 리턴하기 위해
   if (curr->fd_table[fd]) {  //해당 fd에 파일이 있다면
-    lock_acquire(&filesys_lock);
     file_size = file_length(curr->fd_table[fd]);
-    lock_release(&filesys_lock);
   }
   return file_size;  // filesize 반환
 }
 static int system_read(int fd, void *buffer, unsigned size) {
   struct thread *curr = thread_current();
   if (fd < 0 || fd >= curr->fd_size) return -1;  // fd가 유효하지 않은 숫자일 경우
-  validate_user_string(buffer);
-#ifdef VM
-  struct page *page = spt_find_page(&curr->spt, buffer);
-  if (page && !page->writable) system_exit(-1);
-#endif
+  validate_user_buffer(buffer, size, true);       // 버퍼 전체가 쓰기 가능한지
   int read_bytes;
   if (curr->fd_table[fd] == get_std_in()) {  //표준입력인 경우
-    read_bytes = input_getc();
+    read_bytes = input_read(buffer, size);  // 첫 바이트만 기다리고 이미 들어온 입력은 한 번에 복사
   } else if (curr->fd_table[fd] == get_std_out()) {  // 표준 출력일 경우 잘못된 접근이므로 -1리턴
     return -1;
   } else {
     struct file *read_file = curr->fd_table[fd];
     if (!read_file) return -1;
-    lock_acquire(&filesys_lock);  // 동시접근을 막기 위해
     read_bytes = file_read(read_file, buffer, size);
-    lock_release(&filesys_lock);
   }
 
   return read_bytes;
@@ -254,7 +253,7 @@ static int system_read(int fd, void *buffer, unsigned size) {
 static int system_write(int fd, const void *buffer, unsigned size) {
   struct thread *curr = thread_current();
   if (fd < 0 || fd >= curr->fd_size) return -1;  // fd가 유효하지 않은 숫자일 경우
-  validate_user_string(buffer);
+  validate_user_buffer(buffer, size, false);
 
   if (curr->fd_table[fd] == get_std_out()) {  // 표준 출력일 경우
     putbuf(buffer, size);
@@ -265,9 +264,7 @@ static int system_write(int fd, const void *buffer, unsigned size) {
     int write_bytes;
     struct file *write_file = curr->fd_table[fd];
     if (!write_file) return -1;
-    lock_acquire(&filesys_lock);  // 동시접근을 막기 위해
     write_bytes = file_write(write_file, buffer, size);
-    lock_release(&filesys_lock);
     return write_bytes;
   }
 }
@@ -280,9 +277,7 @@ static void system_seek(int fd, unsigned position) {
   struct file *seek_file = curr->fd_table[fd];
   if (!seek_file) return;  // fd size 이내의 숫자이지만 열린 fd가 아니라면 리턴
 
-  lock_acquire(&filesys_lock);  // 동시접근을 막기 위해
   file_seek(seek_file, position);
-  lock_release(&filesys_lock);
 }
 static unsigned system_tell(int fd) {
   struct thread *curr = thread_current();
@@ -293,9 +288,7 @@ static unsigned system_tell(int fd) {
   struct file *tell_file = curr->fd_table[fd];
   if (!tell_file) return 0;  // fd size 이내의 숫자이지만 열린 fd가 아니라면 리턴
 
-  lock_acquire(&filesys_lock);  // 동시접근을 막기 위해
   unsigned tell_bytes = file_tell(tell_file);
-  lock_release(&filesys_lock);
   return tell_bytes;
 }
 void system_close(int fd) {
@@ -308,9 +301,7 @@ void system_close(int fd) {
     if (close_file->dup_count >= 2) {  // 누군가 dup2 되어있을 경우
       close_file->dup_count--;         // dup_count만 내려줍니다.
     } else {
-      lock_acquire(&filesys_lock);  // 동시접근을 막기 위해
       file_close(close_file);       // file 닫아주기
-      lock_release(&filesys_lock);
     }
   }
   curr->fd_table[fd] = NULL;  // fd_table에서 빼주기
@@ -356,6 +347,42 @@ static void *system_mmap(void *addr, size_t length, int writable, int fd, off_t
   return do_mmap(addr, length, writable, thread_current()->fd_table[fd], offset);
 }
 static void system_munmap(void *addr) { do_munmap(addr); }
+static bool system_diskstat(int chan_no, int dev_no, struct diskstat *stats) {
+  if (chan_no < 0 || (dev_no != 0 && dev_no != 1)) return false;
+  struct disk *d = disk_get(chan_no, dev_no);
+  if (!d) return false;  // 없는 디스크
+  validate_user_buffer(stats, sizeof *stats, true);  // 구조체 끝까지 쓰기 가능한지
+
+  /* 인터럽트를 끈 채로는 유저 메모리에 쓸 수 없으므로(page fault) 커널에 먼저 복사 */
+  struct diskstat *copy = malloc(sizeof *copy);
+  if (!copy) return false;
+  disk_stats(d, copy);
+  memcpy(stats, copy, sizeof *copy);
+  free(copy);
+  return true;
+}
+static int system_clock_gettime(clockid_t clock, struct timespec *ts) {
+  if (clock != CLOCK_MONOTONIC) return -1;
+  validate_user_buffer(ts, sizeof *ts, true);
+
+  int64_t ns = timer_ns();
+  ts->tv_sec = ns / 1000000000;
+  ts->tv_nsec = ns % 1000000000;
+  return 0;
+}
+static int system_lockstat(struct lockstat *stats, int max) {
+  if (max <= 0) return 0;
+  if (max > LOCKSTAT_MAX) max = LOCKSTAT_MAX;
+  validate_user_buffer(stats, max * sizeof *stats, true);
+
+  /* 인터럽트를 끈 채로는 유저 메모리에 쓸 수 없으므로(page fault) 커널에 먼저 복사 */
+  struct lockstat *copy = malloc(max * sizeof *copy);
+  if (!copy) return -1;
+  int n = lock_stats(copy, max);
+  if (n > 0) memcpy(stats, copy, n * sizeof *copy);
+  free(copy);
+  return n;
+}
 
 static void validate_user_string(const char *str) {
   if (str == NULL || !is_user_vaddr(str)) {  //주소가 NULL이거나, kernel 영역이거나
@@ -368,6 +395,25 @@ static void validate_user_string(const char *str) {
       system_exit(-1);                                                    //종료
   }
 }
+/* Exits the process unless all SIZE bytes at BUF are user memory
+   that is mapped or may be claimed by stack growth, and, if
+   WRITABLE, that none of it lies in a read-only page.  Checks one
+   address per page, and BUF itself even if SIZE is 0. */
+static void validate_user_buffer(const void *buf, size_t size, bool writable) {
+  const char *p = buf;
+  const char *last = p + (size > 0 ? size - 1 : 0);
+
+  if (last < p) system_exit(-1);  // 주소가 한 바퀴 넘어가는 경우
+  for (;;) {
+    validate_user_string(p);
+#ifdef VM
+    struct page *page = spt_find_page(&thread_current()->spt, (void *)p);
+    if (writable && page && !page->writable) system_exit(-1);  // 읽기 전용 페이지(코드 영역 등)에 쓰려는 경우
+#endif
+    if (pg_round_down(p) == pg_round_down(last)) break;
+    p = (const char *)pg_round_down(p) + PGSIZE;  // 다음 페이지 시작
+  }
+}
 static int expend_fd_table(struct thread *curr, size_t size) {  // MAXFILES의 배수로 ㄱㄱ
   // if (curr->fd_size >= 512) return -1;                          //크기 제한
   size_t size_cnt = size / MAX_FILES + 1;
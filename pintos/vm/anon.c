@@ -1,6 +1,9 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include <bitmap.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "devices/disk.h"
 #include "threads/mmu.h"
@@ -8,7 +11,6 @@
 #include "vm/vm.h"
 
 /* DO NOT MODIFY BELOW LINE */
-static struct disk *swap_disk;
 static bool anon_swap_in(struct page *page, void *kva);
 static bool anon_swap_out(struct page *page);
 static void anon_destroy(struct page *page);
@@ -23,18 +25,58 @@ static const struct page_operations anon_ops = {
 
 int *swap_table;  // swap table, 각 페이지 별 사용 가능한 지 확인용
 static size_t swap_slot_cnt; //총 swap slot 갯수
+static size_t swap_next;     // 다음 빈 slot 탐색을 시작할 위치 (next-fit)
 struct lock swap_lock;      // swap table 접근 시 동기화를 위해 사용
 
+/* swap 스트라이핑: slot i는 swap_disks[i % swap_disk_cnt]의 (i / swap_disk_cnt)번째 페이지.
+   연속된 slot이 서로 다른 디스크로 가므로 여러 디스크에 I/O가 나뉜다. */
+#define MAX_SWAP_DISKS 4
+static struct disk *swap_disks[MAX_SWAP_DISKS];
+static size_t swap_disk_cnt;
+
+/* -swap=CHAN:DEV[,CHAN:DEV...] 커널 옵션 (기본값 1:1) */
+const char *swap_disks_option = "1:1";
+
+#define SECTORS_PER_PAGE (PGSIZE / DISK_SECTOR_SIZE)
+
+/* SWAP_DISKS_OPTION에 적힌 디스크들을 swap_disks에 등록 */
+static void swap_disks_init(void) {
+  char spec[64];
+  char *token, *save_ptr;
+
+  if (!swap_disks_option) PANIC("bad -swap option");
+  strlcpy(spec, swap_disks_option, sizeof spec);
+  for (token = strtok_r(spec, ",", &save_ptr); token != NULL; token = strtok_r(NULL, ",", &save_ptr)) {
+    char *dev = strchr(token, ':');
+    if (!dev || swap_disk_cnt >= MAX_SWAP_DISKS) PANIC("bad -swap option `%s'", swap_disks_option);
+    int chan_no = atoi(token), dev_no = atoi(dev + 1);
+    struct disk *d = (dev_no == 0 || dev_no == 1) ? disk_get(chan_no, dev_no) : NULL;
+    if (!d) PANIC("SWAP DISK %s NOT FOUND", token);
+    swap_disks[swap_disk_cnt++] = d;
+  }
+  if (swap_disk_cnt == 0) PANIC("SWAP DISK NOT FOUND");
+}
+
+/* SLOT이 저장되는 디스크와 시작 섹터 */
+static struct disk *swap_locate(size_t slot, disk_sector_t *sector) {
+  *sector = slot / swap_disk_cnt * SECTORS_PER_PAGE;
+  return swap_disks[slot % swap_disk_cnt];
+}
+
 /* Initialize the data for anonymous pages */
 void vm_anon_init(void) {
-  /* TODO: Set up the swap_disk. */
-  swap_disk = disk_get(1, 1);
-  if (!swap_disk) PANIC("SWAP DISK NOT FOUND");
-  // swap table도 만들어야 함
-  swap_slot_cnt = disk_size(swap_disk) * DISK_SECTOR_SIZE / PGSIZE;  // disk에 들어갈 총 page 갯수
+  swap_disks_init();
+  // swap table도 만들어야 함. 디스크마다 같은 수의 slot을 쓰므로 가장 작은 디스크 기준
+  size_t per_disk = SIZE_MAX;
+  for (size_t i = 0; i < swap_disk_cnt; i++) {
+    size_t pages = disk_size(swap_disks[i]) / SECTORS_PER_PAGE;  // disk에 들어갈 page 갯수
+    if (pages < per_disk) per_disk = pages;
+  }
+  swap_slot_cnt = per_disk * swap_disk_cnt;
+  if (swap_disk_cnt > 1) printf("swap: %zu slots striped over %zu disks\n", swap_slot_cnt, swap_disk_cnt);
   swap_table = calloc(swap_slot_cnt,sizeof(int));
   if (!swap_table) PANIC("CANNOT CREATE SWAP TABLE");  // bitmap 생성 실패 시
-  lock_init(&swap_lock);                               // swap table 접근 시 동기화 용 락
+  lock_init_named(&swap_lock, "swap");                               // swap table 접근 시 동기화 용 락
 }
 
 /* Initialize the file mapping */
@@ -57,11 +99,11 @@ static bool anon_swap_in(struct page *page, void *kva) {
     return false;  // swap_out 된 적 없음
   }
 
-  // disk에서 페이지 읽기(8 sectors)
+  // disk에서 페이지 읽기(8 sectors를 한 번의 명령으로)
   size_t slot = anon_page->swap_index;
-  for (int i = 0; i < 8; i++) {
-    disk_read(swap_disk, slot * 8 + i, kva + i * DISK_SECTOR_SIZE);
-  }
+  disk_sector_t sector;
+  struct disk *disk = swap_locate(slot, &sector);
+  disk_read_multiple(disk, sector, SECTORS_PER_PAGE, kva);
   // swap table에서 slot해제
   lock_acquire(&swap_lock);
   swap_table[slot]--;
@@ -84,10 +126,12 @@ static bool anon_swap_out(struct page *page) {
   // swap table에서 빈 slot 찾기
   lock_acquire(&swap_lock);
   size_t slot = BITMAP_ERROR; //SIZE_MAX와 같음
-  for(size_t i=0;i<swap_slot_cnt;i++){
+  for(size_t n=0;n<swap_slot_cnt;n++){
+    size_t i=(swap_next+n)%swap_slot_cnt; // 직전 slot 다음부터 찾아서 디스크들을 번갈아 사용
     if(swap_table[i]==0){
       slot=i;
       swap_table[i]=1;// 참조 카운트 1로 설정
+      swap_next=i+1;
       break;
     }
   }
@@ -98,10 +142,10 @@ static bool anon_swap_out(struct page *page) {
   }
   lock_release(&swap_lock);
 
-  // disk에 페이지 쓰기( 한 페이지 = 8 sector)
-  for (int i = 0; i < 8; i++) {
-    disk_write(swap_disk, slot * 8 + i, page->frame->kva + i * DISK_SECTOR_SIZE);
-  }
+  // disk에 페이지 쓰기( 한 페이지 = 8 sector, 한 번의 명령으로)
+  disk_sector_t sector;
+  struct disk *disk = swap_locate(slot, &sector);
+  disk_write_multiple(disk, sector, SECTORS_PER_PAGE, page->frame->kva);
   // swap_index 저장
   anon_page->swap_index = slot;
 
@@ -2,6 +2,7 @@
 
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
+#include "filesys/page_cache.h"
 #include "userprog/process.h"
 #include "vm/vm.h"
 
@@ -22,7 +23,11 @@ static const struct page_operations file_ops = {
 };
 
 /* The initializer of file vm */
-void vm_file_init(void) {}
+void vm_file_init(void) {
+#ifndef EFILESYS
+  pagecache_init();  // EFILESYS면 vm_init()에서 띄우므로, 아닐 때만 writeback 데몬을 여기서 띄운다
+#endif
+}
 
 /* Initialize the file backed page */
 bool file_backed_initializer(struct page *page, enum vm_type type, void *kva) {
@@ -77,21 +82,31 @@ static bool file_backed_swap_out(struct page *page) {
   return true;
 }
 
-/* Destory the file backed page. PAGE will be freed by the caller. */
+/* Destory the file backed page. PAGE will be freed by the caller.
+ * Dirty contents are not written here: the frame is handed to the page
+ * cache, whose worker writes it back later. */
 static void file_backed_destroy(struct page *page) {
   struct file_page *file_page = &page->file;
+  struct frame *frame = page->frame;
+  bool dirty = frame != NULL && pml4_is_dirty(thread_current()->pml4, page->va);
 
-  // dirty bit 확인 후 write back
-  if (pml4_is_dirty(thread_current()->pml4, page->va) && page->frame) {
-    file_write_at(file_page->file, page->frame->kva, file_page->read_bytes, file_page->ofs);
-  }
   //페이지 테이블에서 매핑 제거
   pml4_clear_page(thread_current()->pml4, page->va);
-  if (page->frame != NULL) {
+  if (frame == NULL) return;
+
+  // frame table에서 제거
+  lock_acquire(&frame_table_lock);
+  list_remove(&frame->elem);
+  lock_release(&frame_table_lock);
+
+  if (dirty && file_page->read_bytes > 0) {
+    // dirty면 물리 메모리를 page cache에 넘긴다 (write back 후 데몬이 해제)
+    page_cache_queue(file_get_inode(file_page->file), file_page->ofs, file_page->read_bytes, frame->kva);
+  } else {
     //물리 메모리 해제
-    palloc_free_page(page->frame->kva);
-    free(page->frame);
+    palloc_free_page(frame->kva);
   }
+  free(frame);
 }
 
 /* Do the mmap */
@@ -226,11 +241,7 @@ void do_munmap(void *addr) {
       spt_remove_page(&curr->spt, page);
       continue;
     }
-    // dirty면 파일에 write back
-    if (pml4_is_dirty(curr->pml4, va) && page->frame) {
-      file_write_at(mmap->file, page->frame->kva, page->file.read_bytes, page->file.ofs);
-    }
-    // spt에서 페이지 제거
+    // spt에서 페이지 제거 (dirty면 destroy에서 page cache로 write back을 넘긴다)
     spt_remove_page(&curr->spt, page);
   }
   // mmap_file을 리스트에서 제거
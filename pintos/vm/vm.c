@@ -11,6 +11,7 @@
 #include "userprog/process.h"
 #include "vm/inspect.h"
 #include "threads/thread.h"
+#include "filesys/page_cache.h"
 
 static struct list frame_table;       //모든 frame들의 리스트
 struct lock frame_table_lock;  // frame_table 동기화용 (COW : static 제거, extern 접근 목적)
@@ -28,7 +29,7 @@ void vm_init(void) {
   /* DO NOT MODIFY UPPER LINES. */
   /* TODO: Your code goes here. */
   list_init(&frame_table);
-  lock_init(&frame_table_lock);
+  lock_init_named(&frame_table_lock, "frame_table");
   clock_hand = NULL;
 }
 
@@ -205,6 +206,8 @@ static struct frame *vm_get_frame(void) {
   /* TODO: Fill this function. */
 
   int8_t *kaddr = palloc_get_page(PAL_USER);
+  if (kaddr == NULL && page_cache_reclaim())  // writeback 대기중인 페이지들을 kworker가 내보내서 확보되면 다시 시도
+    kaddr = palloc_get_page(PAL_USER);
   if (kaddr == NULL) {
     frame = vm_evict_frame();  // evict 하고 frame 재사용
     if (frame == NULL) {
@@ -223,7 +226,7 @@ static struct frame *vm_get_frame(void) {
 
   /* cow용 추가 */
   frame->ref_count=1;
-  lock_init(&frame->lock);
+  lock_init_named(&frame->lock, "frame");
 
   // frame_table에 추가
   lock_acquire(&frame_table_lock);